@@ -0,0 +1,33 @@
+#ifndef ASSIGN_BLOCKED_H
+#define ASSIGN_BLOCKED_H
+#include "common.h"
+
+// Nearest-centre assignment for large k.
+// ||x - c||^2 = ||x||^2 - 2 x.c + ||c||^2, and ||x||^2 is the same for every centre, so the argmin only needs
+// ||c||^2 - 2 x.c: one multiply-add per coordinate with ||c||^2 and -2c computed once per iteration.
+// Points are copied a tile at a time into structure of arrays and every centre tile is streamed past them, keeping a
+// running argmin per point in L1: the point x centre distance matrix never exists.
+// The inner loop is branch free and needs -O3 (or -ftree-vectorize) to be vectorized, see app/CmakeLists.txt.
+// The expanded form rounds differently from the direct distance, so exact near-ties may pick the other centre.
+// The app's cluster arrays stop at K_MAX, this backend does not: src/assign_bench.c checks and times it into the thousands.
+
+#define ASSIGN_TILE_POINTS   256 // running best distance and label of a point tile
+#define ASSIGN_TILE_CENTERS  64  // 4 floats per centre, 1 KB per tile
+#define ASSIGN_BLOCKED_MIN_K 16  // below this the direct loop is as fast
+
+typedef struct
+{
+  float *x;    // -2 c.x
+  float *y;    // -2 c.y
+  float *z;    // -2 c.z
+  float *norm; // ||c||^2
+  size_t k;
+  size_t capacity;
+} CenterBlock;
+
+void center_block_prepare(CenterBlock *b, const Vector3 *centers, size_t k);
+void center_block_free(CenterBlock *b);
+void assign_blocked(const CenterBlock *b, const Vector3 *points, size_t n, int *out);
+void assign_direct(const Vector3 *points, size_t n, const Vector3 *centers, size_t k, int *out); // reference loop, any k
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef CORESET_H
+#define CORESET_H
+#include "common.h"
+
+// Lightweight coresets (Bachem, Lucic, Krause - "Scalable k-Means Clustering via Lightweight Coresets", KDD 2018).
+// Points are sampled with probability q(x) = 1/2 * w(x)/W + 1/2 * w(x) d(x, mu)^2 / sum w d^2 and weighted w(x) / (m q(x)).
+// With m = O((d k log k + log 1/delta) / eps^2) samples, with probability 1 - delta the weighted cost of any k centres
+// on the coreset is within eps * (cost(X, C) + cost(X, {mu})) of their cost on the full set.
+// Building is two linear passes, solving then only touches the m samples.
+
+#define CORESET_SIZE_PER_K 200
+#define CORESET_MIN_SIZE   1024
+#define CORESET_MAX_ITER   100
+
+typedef struct
+{
+  Vector3 *items;
+  float   *weights;
+  int     *labels;
+  size_t   count;
+  size_t   capacity;
+} WeightedSamples3D;
+
+void   coreset_build(const Vector3 *points, const float *w, size_t n, size_t m, WeightedSamples3D *out);
+size_t coreset_kmeans(WeightedSamples3D *c, Vector3 *centers, size_t k, size_t max_iter);
+void   coreset_free(WeightedSamples3D *c);
+
+#endif
@@ -1,11 +1,26 @@
 #ifndef KMEANS_H
 #define KMEANS_H
 #include "common.h"
+#include "reduce.h"
 
-void randomize_means(size_t k, float bound);
-void reset_set(Samples3D *s);
-void append_to_cluster(Samples3D *s, Vector3 p);
-void recluster_state(size_t kl);
-void update_means(float cluster_radius,  size_t k);
+// set.items are unweighted; weighted points only exist as summaries (see coreset.h) and pass their weights explicitly
+extern int   *labels;               // cluster of set.items[i] from the last recluster_state
+extern size_t labels_count;
+extern size_t labels_capacity;
+extern double online_counts[K_MAX]; // points behind each target mean, kept by recluster_state and kmeans_ingest
+
+void   randomize_means(size_t k, float bound);
+void   reset_set(Samples3D *s);
+void   append_to_cluster(Samples3D *s, Vector3 p);
+void   recluster_state(size_t kl);
+void   regroup_clusters(size_t kl);
+size_t kmeans_assign_range(size_t begin, size_t end, size_t kl, CentroidSums *sums);
+void   kmeans_place_set(void);
+void   kmeans_group_range(size_t begin, size_t end, size_t kl, size_t *fill);
+void   kmeans_group_publish(size_t kl, const size_t *fill);
+void   apply_means(double (*sum)[4], float cluster_radius, size_t k);
+void   kmeans_ingest(const Vector3 *points, size_t n, size_t k, size_t window);
+void   kmeans_assign(const Vector3 *points, size_t n, const Vector3 *centers, size_t k, int *out);
+void   kmeans_weighted_means(const Vector3 *points, const float *w, const int *lab, size_t n, size_t k, Vector3 *centers, double *mass);
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef NUMA_H
+#define NUMA_H
+#include "common.h"
+
+// NUMA topology and placement.
+// Nodes and their cpus are read from /sys/devices/system/node; anything else (no sysfs, one node) is one node holding
+// every cpu. With numa_aware set, parallel_run pins worker tid to a cpu of node tid % nodes, and the k-means passes hand
+// REDUCE_BLOCK sized blocks of the point set to nodes round robin: kmeans_place_set copies each block from a thread of
+// its node so the first touch puts its pages there, and every pass later reads it from that node only.
+// Only cpus the process may run on (sched_getaffinity, e.g. under taskset or a cpuset) are used for pinning; nodes
+// without one are left out.
+// Placed buffers come from numa_alloc_pages, fresh anonymous mappings no one has touched yet, kept on base pages since
+// a transparent huge page would cover blocks of several nodes; buffers that may be placed
+// (set.items, labels) are grown with numa_realloc and released with numa_free, which accept plain malloc memory too.
+
+#define NUMA_MAX_NODES 16
+
+extern bool numa_aware;
+
+size_t numa_node_count(void);
+size_t numa_thread_node(size_t tid);
+int    numa_thread_cpu(size_t tid); // -1 when the cpus are unknown
+size_t numa_current_node(void);     // node of the calling parallel_run worker, 0 elsewhere
+void   numa_set_current_node(size_t node);
+
+void *numa_alloc_pages(size_t bytes);
+void *numa_realloc(void *p, size_t bytes);
+void  numa_free(void *p);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include "common.h"
+
+// Fork-join helper: runs task(ctx, tid, threads) on `threads` threads, the caller being tid 0, and returns when all are done.
+// Tasks split their work by tid themselves, see parallel_range.
+// With numa_aware set every tid runs on a worker pinned to a cpu of node numa_thread_node(tid), see numa.h.
+
+#define PARALLEL_MAX_THREADS 256
+
+typedef void (*ParallelTask)(void *ctx, size_t tid, size_t threads);
+
+extern size_t parallel_threads; // 0 detects the number of online cores
+
+size_t parallel_thread_count(void);
+void   parallel_run(size_t threads, ParallelTask task, void *ctx);
+void   parallel_range(size_t count, size_t tid, size_t threads, size_t *begin, size_t *end);
+
+#endif
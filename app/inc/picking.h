@@ -0,0 +1,40 @@
+#ifndef PICKING_H
+#define PICKING_H
+#include "common.h"
+
+// Uniform grid over the point set for mouse picking.
+// Cells are at least one point wide and every point is stored in each cell its box overlaps,
+// so walking the cells along the ray (3D DDA) can stop at the first cell that contains a hit.
+// The grid only stores indices into the point array: labels are looked up at query time,
+// and centroids (at most K_MAX, moving every frame) are tested directly, so neither needs a rebuild.
+
+#define PICK_POINTS_PER_CELL 4
+#define PICK_MAX_DIM         512
+
+typedef struct
+{
+  Vector3        min;
+  float          cell;
+  int            dim[3];
+  float          radius;     // half size of the box drawn for each point
+  size_t        *cell_start; // points of cell c are indices[cell_start[c] .. cell_start[c + 1])
+  size_t        *indices;
+  size_t         cell_capacity;
+  size_t         index_capacity;
+  const Vector3 *items;
+  size_t         count;
+} PickGrid;
+
+typedef struct
+{
+  bool   hit;
+  bool   is_centroid;
+  size_t index; // into the point array, or the centroid index
+  float  distance;
+} PickResult;
+
+void       pick_grid_build(PickGrid *g, const Vector3 *items, size_t count, float radius);
+void       pick_grid_free(PickGrid *g);
+PickResult pick_ray(const PickGrid *g, Ray ray, const Vector3 *centers, size_t k, float center_radius);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+#include "common.h"
+
+// Offscreen recording of the clustering scene.
+// Frames are rendered into a RenderTexture2D, read back through a ring of pixel buffers
+// and handed to a writer thread that does the encoding and file I/O.
+// recorder_submit never waits: if the GPU or the writer falls behind the frame is dropped and counted.
+
+#define RECORDER_PBO_COUNT   3 // readbacks in flight on the GPU
+#define RECORDER_RING_SIZE   8 // frames queued for the writer thread
+#define RECORDER_DEFAULT_FPS 30
+
+typedef enum
+{
+  RECORD_Y4M, // single YUV4MPEG2 stream (C444), playable with ffplay / mpv, ffmpeg -i out.y4m
+  RECORD_RAW, // raw RGBA frames, top row first
+  RECORD_PNG, // <path>_000000.png, <path>_000001.png ...
+} RecordFormat;
+
+typedef struct
+{
+  size_t submitted; // frames passed to recorder_submit
+  size_t written;   // frames encoded by the writer thread
+  size_t dropped;   // frames skipped because a buffer was still busy
+} RecordStats;
+
+bool         recorder_start(const char *path, RecordFormat format, int width, int height, int fps);
+void         recorder_submit(RenderTexture2D target);
+void         recorder_stop(void);
+bool         recorder_active(void);
+RecordStats  recorder_stats(void);
+RecordFormat recorder_format_from_string(const char *name);
+
+#endif
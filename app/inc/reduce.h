@@ -0,0 +1,36 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+#include "common.h"
+#include "numa.h"
+
+// Centroid sums, sum[c] = {sum w x, sum w y, sum w z, sum w}, gathered from several threads.
+// The fast mode gives every caller its own double partials and adds them to the total of its NUMA node as each one
+// finishes, the node totals being merged once by centroid_sums_finish; the rounding depends on the thread count and
+// on which thread finishes first.
+// The deterministic mode accumulates points in index order into fixed blocks of REDUCE_BLOCK points
+// and adds the blocks up along a fixed pairwise tree: the result only depends on the points, never on how
+// the work was split between threads or time slices.
+
+#define REDUCE_BLOCK 4096
+
+extern bool deterministic_reduction;
+
+typedef struct
+{
+  bool   deterministic;                // mode when centroid_sums_begin was called
+  size_t k;
+  double sum[NUMA_MAX_NODES][K_MAX][4]; // fast mode totals, per node
+  double (*blocks)[4];                  // deterministic mode, k partials per block
+  size_t block_count;                   // blocks touched so far
+  size_t block_capacity;
+} CentroidSums;
+
+// Adds w[i] * points[i] (w NULL: weight 1) to sum[lab[i]] for i in [begin, end); labels outside [0, k) are skipped
+void centroid_accumulate(const Vector3 *points, const float *w, const int *lab, size_t begin, size_t end, size_t k, double (*sum)[4]);
+void centroid_sums_begin(CentroidSums *r, size_t count, size_t k);
+void centroid_sums_reserve(CentroidSums *r, size_t count);
+void centroid_sums_add(CentroidSums *r, const Vector3 *points, const float *w, const int *lab, size_t begin, size_t end);
+void centroid_sums_finish(CentroidSums *r, double (*sum)[4]);
+void centroid_sums_free(CentroidSums *r);
+
+#endif
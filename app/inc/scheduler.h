@@ -0,0 +1,52 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "common.h"
+#include "reduce.h"
+
+// Runs Lloyd iterations inside a per-frame time budget instead of one full iteration per frame.
+// An iteration is an assignment pass, which also accumulates the new centroids, followed by a regroup pass
+// filling a second set of per-cluster arrays, swapped with the drawn ones once complete, so no frame shows a half
+// regrouped set. Both are split into slices sized from their measured cost per point, so a cheap set gets many iterations per frame and an expensive one spreads a single iteration over several frames.
+// Iterations stop once an assignment pass changes no label, until scheduler_reset. The first pass after a reset always
+// moves the means: callers usually just relabelled the set against them, so its labels alone prove nothing.
+
+#define SCHED_DEFAULT_BUDGET_MS 8.0
+#define SCHED_MIN_BUDGET_MS     1.0
+#define SCHED_MAX_BUDGET_MS     100.0
+#define SCHED_MIN_SLICE         256
+#define SCHED_HEADROOM          0.9 // fraction of the remaining budget a slice is sized for, the cost estimate is noisy
+
+typedef enum
+{
+  SCHED_ASSIGN,
+  SCHED_GROUP,
+} SchedPhase;
+
+typedef struct
+{
+  double       budget_ms;
+  SchedPhase   phase;
+  size_t       cursor;          // next point of the current pass
+  size_t       changed;         // labels changed so far in the assignment pass
+  CentroidSums sums;            // centroid sums of the assignment pass
+  size_t       fill[K_MAX];     // cluster sizes written so far by the regroup pass
+  size_t       slice[2];        // points per slice, per phase
+  double       ns_per_point[2]; // smoothed cost of one point, per phase
+  bool         converged;
+  bool         fresh;           // no means applied since the last reset
+
+  // what the last scheduler_step did, for the HUD
+  size_t iterations;       // iterations completed this frame
+  size_t slices;           // slices run this frame
+  size_t pass_frames;      // frames the current pass has spanned so far
+  size_t last_pass_frames; // frames the previous pass took
+  double used_ms;          // time spent this frame
+  size_t total_iterations;
+} Scheduler;
+
+void scheduler_init(Scheduler *s);
+void scheduler_reset(Scheduler *s);
+void scheduler_free(Scheduler *s);
+void scheduler_step(Scheduler *s, size_t k, float cluster_radius);
+
+#endif
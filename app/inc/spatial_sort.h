@@ -0,0 +1,25 @@
+#ifndef SPATIAL_SORT_H
+#define SPATIAL_SORT_H
+#include "common.h"
+
+// Reorders a point set along a Morton (Z-order) curve so that points close in space are close in memory.
+// Consecutive points then tend to share their nearest centroid, and the per-cluster arrays built from the
+// set inherit the same order for rendering.
+// The permutation is kept so results can be reported against the original point indices, and to undo the sort.
+
+#define MORTON_BITS 10 // per axis, 30 bit keys
+#define RADIX_BITS  10 // three passes over the key
+
+typedef struct
+{
+  size_t *perm; // perm[i] = original index of the point now stored at i
+  size_t  count;
+  size_t  capacity;
+} SpatialOrder;
+
+void spatial_order_reset(SpatialOrder *order, size_t count);
+void spatial_order_free(SpatialOrder *order);
+void spatial_sort(Samples3D *s, SpatialOrder *order);
+bool spatial_unsort(Samples3D *s, SpatialOrder *order);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include "common.h"
+
+// Live point ingestion. A producer thread reads "x y z" lines (blank lines and lines starting with # are skipped)
+// from a file that is followed like tail -f, a named pipe, or stdin ("-"), and queues them.
+// The render thread drains the queue with stream_poll, which never waits, and feeds kmeans_ingest.
+
+#define STREAM_QUEUE_SIZE     65536
+#define STREAM_DEFAULT_WINDOW 100000 // points kept before the oldest ones age out
+#define STREAM_MAX_PER_FRAME  20000  // points ingested per frame at most
+#define STREAM_MAX_COORD      1e9f   // larger (or non-finite) coordinates are rejected: squared distances must stay finite
+
+typedef struct
+{
+  size_t received; // points parsed by the producer
+  size_t ingested; // points handed to the engine
+  size_t rejected; // lines that could not be parsed
+} StreamStats;
+
+bool        stream_start(const char *path);
+void        stream_stop(void);
+size_t      stream_poll(Vector3 *out, size_t max);
+bool        stream_active(void);
+StreamStats stream_stats(void);
+
+#endif
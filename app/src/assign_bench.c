@@ -0,0 +1,65 @@
+// Times assign_blocked against the direct loop for k well past K_MAX and checks that both pick the same centres.
+// Usage: 3dKMeans-assign-bench [points] ; exits with 1 if a label differs by more than a rounding near-tie.
+#include "assign_blocked.h"
+#include <time.h>
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static Vector3 random_point(float extent)
+{
+  return (Vector3){extent * rand() / RAND_MAX, extent * rand() / RAND_MAX, extent * rand() / RAND_MAX};
+}
+
+int main(int argc, char **argv)
+{
+  size_t       n      = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+  const size_t ks[]   = {16, 70, 256, 1000, 4000};
+  bool         failed = false;
+
+  srand(1);
+  Vector3 *points = malloc(n * sizeof(Vector3));
+  int     *direct = malloc(n * sizeof(int));
+  int     *tiled  = malloc(n * sizeof(int));
+  for(size_t i = 0; i < n; ++i) points[i] = random_point(300.0f);
+
+  for(size_t t = 0; t < sizeof(ks) / sizeof(ks[0]); ++t)
+    {
+      size_t   k       = ks[t];
+      Vector3 *centers = malloc(k * sizeof(Vector3));
+      for(size_t j = 0; j < k; ++j) centers[j] = random_point(300.0f);
+
+      double t0 = now_ms();
+      assign_direct(points, n, centers, k, direct);
+      double t1 = now_ms();
+
+      CenterBlock b = {0};
+      center_block_prepare(&b, centers, k);
+      assign_blocked(&b, points, n, tiled);
+      double t2 = now_ms();
+      center_block_free(&b);
+
+      // labels may only differ where both centres are equally close up to rounding
+      size_t ties = 0, wrong = 0;
+      for(size_t i = 0; i < n; ++i)
+        {
+          if(direct[i] == tiled[i]) continue;
+          float a = Vector3DistanceSqr(points[i], centers[direct[i]]);
+          float c = Vector3DistanceSqr(points[i], centers[tiled[i]]);
+          if(fabsf(a - c) <= 1e-3f * a + 1e-2f) ties++;
+          else wrong++;
+        }
+      printf("k=%5zu  direct %8.1f ms  blocked %8.1f ms  %5.1fx  near-ties %zu  mismatches %zu\n", k, t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1), ties, wrong);
+      failed |= wrong > 0;
+      free(centers);
+    }
+
+  free(points);
+  free(direct);
+  free(tiled);
+  return failed ? 1 : 0;
+}
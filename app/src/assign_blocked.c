@@ -0,0 +1,99 @@
+#include "assign_blocked.h"
+#include "float.h"
+
+void center_block_prepare(CenterBlock *b, const Vector3 *centers, size_t k)
+{
+  if(b->capacity < k)
+    {
+      b->capacity = k;
+      b->x        = realloc(b->x, k * sizeof(float));
+      b->y        = realloc(b->y, k * sizeof(float));
+      b->z        = realloc(b->z, k * sizeof(float));
+      b->norm     = realloc(b->norm, k * sizeof(float));
+    }
+  for(size_t j = 0; j < k; ++j)
+    {
+      Vector3 c  = centers[j];
+      b->x[j]    = -2.0f * c.x;
+      b->y[j]    = -2.0f * c.y;
+      b->z[j]    = -2.0f * c.z;
+      b->norm[j] = c.x * c.x + c.y * c.y + c.z * c.z;
+    }
+  b->k = k;
+}
+
+void center_block_free(CenterBlock *b)
+{
+  free(b->x);
+  free(b->y);
+  free(b->z);
+  free(b->norm);
+  *b = (CenterBlock){0};
+}
+
+void assign_direct(const Vector3 *points, size_t n, const Vector3 *centers, size_t k, int *out)
+{
+  for(size_t i = 0; i < n; ++i)
+    {
+      int   best = -1;
+      float s    = FLT_MAX;
+      for(size_t j = 0; j < k; ++j)
+        {
+          float sm = Vector3DistanceSqr(points[i], centers[j]);
+          if(sm < s)
+            {
+              s    = sm;
+              best = j;
+            }
+        }
+      out[i] = best;
+    }
+}
+
+// One point tile (structure of arrays) against centres [j0, j1). The loop over points has no branch, the label
+// is picked with a compare mask, so it vectorizes; the centre being tested sits in registers.
+static void assign_tile(const CenterBlock *b, const float *restrict px, const float *restrict py, const float *restrict pz, size_t m, size_t j0, size_t j1,
+                        float *restrict best, int *restrict arg)
+{
+  for(size_t j = j0; j < j1; ++j)
+    {
+      float cx = b->x[j], cy = b->y[j], cz = b->z[j], cn = b->norm[j];
+      int   id = (int)j;
+      for(size_t i = 0; i < m; ++i)
+        {
+          float d    = cn + px[i] * cx + py[i] * cy + pz[i] * cz;
+          int   mask = -(d < best[i]);
+          best[i]    = d < best[i] ? d : best[i];
+          arg[i]     = (arg[i] & ~mask) | (id & mask);
+        }
+    }
+}
+
+void assign_blocked(const CenterBlock *b, const Vector3 *points, size_t n, int *out)
+{
+  float px[ASSIGN_TILE_POINTS], py[ASSIGN_TILE_POINTS], pz[ASSIGN_TILE_POINTS];
+  float best[ASSIGN_TILE_POINTS];
+  int   arg[ASSIGN_TILE_POINTS];
+
+  for(size_t i0 = 0; i0 < n; i0 += ASSIGN_TILE_POINTS)
+    {
+      size_t m = n - i0 < ASSIGN_TILE_POINTS ? n - i0 : ASSIGN_TILE_POINTS;
+      for(size_t i = 0; i < m; ++i)
+        {
+          px[i]   = points[i0 + i].x;
+          py[i]   = points[i0 + i].y;
+          pz[i]   = points[i0 + i].z;
+          best[i] = FLT_MAX;
+          arg[i]  = -1;
+        }
+
+      // the point tile stays in L1 while every centre tile is streamed past it
+      for(size_t j0 = 0; j0 < b->k; j0 += ASSIGN_TILE_CENTERS)
+        {
+          size_t j1 = j0 + ASSIGN_TILE_CENTERS < b->k ? j0 + ASSIGN_TILE_CENTERS : b->k;
+          assign_tile(b, px, py, pz, m, j0, j1, best, arg);
+        }
+
+      for(size_t i = 0; i < m; ++i) out[i0 + i] = arg[i];
+    }
+}
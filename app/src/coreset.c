@@ -0,0 +1,152 @@
+#include "coreset.h"
+#include "kmeans.h"
+#include "float.h"
+
+// rand() alone only has 15 bits on some platforms, not enough to sample from millions of points
+static double uniform01(void)
+{
+  return ((double)rand() * ((double)RAND_MAX + 1.0) + rand()) / (((double)RAND_MAX + 1.0) * ((double)RAND_MAX + 1.0));
+}
+
+// First index whose cumulative value exceeds u
+static size_t sample_cdf(const double *cdf, size_t n, double u)
+{
+  size_t lo = 0, hi = n - 1;
+  while(lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if(cdf[mid] <= u) lo = mid + 1;
+      else hi = mid;
+    }
+  return lo;
+}
+
+static void reserve(WeightedSamples3D *c, size_t m)
+{
+  if(c->capacity >= m) return;
+  c->capacity = m;
+  c->items    = realloc(c->items, m * sizeof(Vector3));
+  c->weights  = realloc(c->weights, m * sizeof(float));
+  c->labels   = realloc(c->labels, m * sizeof(int));
+}
+
+void coreset_build(const Vector3 *points, const float *w, size_t n, size_t m, WeightedSamples3D *out)
+{
+  out->count = 0;
+  if(n == 0 || m == 0) return;
+  reserve(out, m);
+
+  double total = 0, mx = 0, my = 0, mz = 0;
+  for(size_t i = 0; i < n; ++i)
+    {
+      double wi = w ? w[i] : 1.0;
+      mx += wi * points[i].x;
+      my += wi * points[i].y;
+      mz += wi * points[i].z;
+      total += wi;
+    }
+  if(total <= 0) return;
+  Vector3 mu = {(float)(mx / total), (float)(my / total), (float)(mz / total)};
+
+  double *cdf  = malloc(n * sizeof(double));
+  double  cost = 0;
+  for(size_t i = 0; i < n; ++i)
+    {
+      cdf[i] = (w ? w[i] : 1.0) * Vector3DistanceSqr(points[i], mu);
+      cost += cdf[i];
+    }
+
+  // q(x) = 1/2 w/W + 1/2 w d^2 / cost, turned into a running sum
+  double running = 0;
+  for(size_t i = 0; i < n; ++i)
+    {
+      double wi = w ? w[i] : 1.0;
+      double q  = 0.5 * wi / total + (cost > 0 ? 0.5 * cdf[i] / cost : 0.5 * wi / total);
+      running += q;
+      cdf[i] = running;
+    }
+
+  for(size_t s = 0; s < m; ++s)
+    {
+      size_t i = sample_cdf(cdf, n, uniform01() * running);
+      double q = (cdf[i] - (i > 0 ? cdf[i - 1] : 0)) / running;
+
+      out->items[s]   = points[i];
+      out->weights[s] = (float)((w ? w[i] : 1.0) / (m * q));
+      out->labels[s]  = -1;
+    }
+  out->count = m;
+  free(cdf);
+}
+
+// Weighted k-means++ seeding
+static void seed_centers(const WeightedSamples3D *c, Vector3 *centers, size_t k)
+{
+  double *d2    = malloc(c->count * sizeof(double));
+  double  total = 0;
+  for(size_t i = 0; i < c->count; ++i)
+    {
+      d2[i] = c->weights[i];
+      total += d2[i];
+    }
+
+  for(size_t j = 0; j < k; ++j)
+    {
+      double u    = uniform01() * total, acc = 0;
+      size_t pick = c->count - 1;
+      for(size_t i = 0; i < c->count; ++i)
+        {
+          acc += d2[i];
+          if(acc > u)
+            {
+              pick = i;
+              break;
+            }
+        }
+      centers[j] = c->items[pick];
+
+      total = 0;
+      for(size_t i = 0; i < c->count; ++i)
+        {
+          double d = c->weights[i] * Vector3DistanceSqr(c->items[i], centers[j]);
+          if(j == 0 || d < d2[i]) d2[i] = d;
+          total += d2[i];
+        }
+      if(total <= 0) total = DBL_MIN;
+    }
+  free(d2);
+}
+
+size_t coreset_kmeans(WeightedSamples3D *c, Vector3 *centers, size_t k, size_t max_iter)
+{
+  if(c->count == 0 || k == 0) return 0;
+  seed_centers(c, centers, k);
+
+  double *mass = malloc(k * sizeof(double));
+  int    *next = malloc(c->count * sizeof(int));
+  size_t  iter = 0;
+  while(iter < max_iter)
+    {
+      iter++;
+      size_t changed = 0;
+      kmeans_assign(c->items, c->count, centers, k, next);
+      for(size_t i = 0; i < c->count; ++i)
+        {
+          changed += next[i] != c->labels[i];
+          c->labels[i] = next[i];
+        }
+      if(changed == 0) break;
+      kmeans_weighted_means(c->items, c->weights, c->labels, c->count, k, centers, mass);
+    }
+  free(next);
+  free(mass);
+  return iter;
+}
+
+void coreset_free(WeightedSamples3D *c)
+{
+  free(c->items);
+  free(c->weights);
+  free(c->labels);
+  *c = (WeightedSamples3D){0};
+}
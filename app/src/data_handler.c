@@ -1,5 +1,6 @@
 
 #include "data_handler.h"
+#include "numa.h"
 
 // static void generate_cluster(Vector3 center, float radius, size_t count, Samples3D *samples)
 // {
@@ -46,7 +47,7 @@ static void generate_cluster(Vector3 center, float stddev, size_t count, Samples
       if(samples->count == samples->capacity)
         {
           samples->capacity *= 2;
-          samples->items = realloc(samples->items, samples->capacity * sizeof(Vector3));
+          samples->items = numa_realloc(samples->items, samples->capacity * sizeof(Vector3)); // set.items may be placed
         }
 
       float theta = GetRandomValue(0, 360) * DEG2RAD;
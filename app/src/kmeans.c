@@ -1,7 +1,22 @@
 
 #include "kmeans.h"
+#include "assign_blocked.h"
+#include "parallel.h"
+#include "numa.h"
+#include <string.h>
 #include "float.h"
 #define C_ALPHA 0.2f
+#define KMEANS_PARALLEL_MIN (16 * REDUCE_BLOCK) // smaller ranges are assigned on the calling thread
+
+int   *labels          = NULL;
+size_t labels_count    = 0;
+size_t labels_capacity = 0;
+double online_counts[K_MAX];
+
+static size_t      online_head = 0; // next slot of the sliding window to overwrite
+static CenterBlock range_block = {0}; // target_means prepared for kmeans_assign_range
+static Samples3D   regrouped[K_MAX];  // per-cluster arrays kmeans_group_range fills while cluster[] is drawn
+
 static void randomize_means(size_t k, float bound)
 {
   for(size_t i = 0; i < k; ++i)
@@ -19,7 +34,7 @@ static void randomize_means(size_t k, float bound)
 
 static void reset_set(Samples3D *s)
 {
-  if(s->items) free(s->items);
+  if(s->items) numa_free(s->items);
   s->items    = NULL;
   s->count    = 0;
   s->capacity = 0;
@@ -35,51 +50,319 @@ static void append_to_cluster(Samples3D *cluster, Vector3 p)
 
   else if(cluster->count == cluster->capacity)
     {
-      cluster->items = realloc(cluster->items, cluster->capacity * sizeof(Vector3) * 2);
+      cluster->items = numa_realloc(cluster->items, cluster->capacity * sizeof(Vector3) * 2);
       cluster->capacity *= 2;
     }
   cluster->items[cluster->count] = p;
   cluster->count++;
 }
 
+static void reserve_labels(size_t count)
+{
+  if(labels_capacity >= count) return;
+  labels_capacity = labels_capacity * 2 > count ? labels_capacity * 2 : count;
+  labels          = numa_realloc(labels, labels_capacity * sizeof(int));
+}
+
 static void recluster_state(size_t kl)
 {
-  for(int i = 0; i < kl; ++i) { cluster[i].count = 0; }
+  kmeans_assign_range(0, set.count, kl, NULL);
+  labels_count = set.count;
+  regroup_clusters(kl);
+}
+
+// Rebuild the per-cluster arrays from the labels without reassigning anything
+void regroup_clusters(size_t kl)
+{
+  for(size_t i = 0; i < kl; ++i) { cluster[i].count = 0; }
+  for(size_t i = 0; i < labels_count; ++i)
+    {
+      if(labels[i] >= 0 && labels[i] < (int)kl) append_to_cluster(&cluster[labels[i]], set.items[i]);
+    }
+  for(size_t i = 0; i < kl; ++i) { online_counts[i] = cluster[i].count; }
+  current_k = kl;
+}
+
+typedef struct
+{
+  size_t        begin, end, kl;
+  CentroidSums *sums;
+  size_t        changed[PARALLEL_MAX_THREADS];
+} AssignJob;
 
-  for(size_t i = 0; i < set.count; ++i)
+// Labels set.items[begin, end) and adds them to the sums, one tile at a time
+static size_t assign_span(size_t begin, size_t end, size_t kl, CentroidSums *sums)
+{
+  size_t changed = 0;
+  int    next[ASSIGN_TILE_POINTS];
+  for(size_t i0 = begin; i0 < end; i0 += ASSIGN_TILE_POINTS)
     {
-      Vector3 p = set.items[i];
-      int     k = -1;
-      float   s = FLT_MAX;
-      for(size_t j = 0; j < kl; ++j)
+      size_t n = end - i0 < ASSIGN_TILE_POINTS ? end - i0 : ASSIGN_TILE_POINTS;
+      if(kl >= ASSIGN_BLOCKED_MIN_K) assign_blocked(&range_block, &set.items[i0], n, next);
+      else kmeans_assign(&set.items[i0], n, target_means, kl, next);
+      for(size_t i = 0; i < n; ++i)
         {
-          Vector3 m  = target_means[j];
-          float   sm = Vector3Distance(p, m);
-          if(sm < s)
+          int previous = i0 + i < labels_count ? labels[i0 + i] : -1;
+          changed += next[i] != previous;
+          labels[i0 + i] = next[i];
+        }
+    }
+  if(sums) centroid_sums_add(sums, set.items, NULL, labels, begin, end);
+  return changed;
+}
+
+// Every node needs at least one thread to own its blocks
+static size_t kmeans_thread_count(void)
+{
+  size_t threads = parallel_thread_count();
+  if(numa_aware && threads < numa_node_count()) threads = numa_node_count();
+  return threads;
+}
+
+// Blocks [first, last) thread tid works on: a contiguous share, or with numa_aware a share of the blocks of its node,
+// block b belonging to node b % nodes. Returned as the blocks *b0 + j * *stride for j in [*lo, *hi).
+static void owned_blocks(size_t first, size_t last, size_t tid, size_t threads, size_t *b0, size_t *stride, size_t *lo, size_t *hi)
+{
+  if(!numa_aware)
+    {
+      *b0     = first;
+      *stride = 1;
+      parallel_range(last - first, tid, threads, lo, hi);
+      return;
+    }
+  size_t nodes = numa_node_count(), node = numa_thread_node(tid);
+  size_t peers = (threads - node + nodes - 1) / nodes; // threads of this node
+  *b0          = first + (node + nodes - first % nodes) % nodes;
+  *stride      = nodes;
+  parallel_range(*b0 < last ? (last - *b0 + nodes - 1) / nodes : 0, tid / nodes, peers, lo, hi);
+}
+
+// Every thread takes whole REDUCE_BLOCKs of the range, so no block of the sums is shared between threads
+static void assign_task(void *ctx, size_t tid, size_t threads)
+{
+  AssignJob *job   = ctx;
+  size_t     first = job->begin / REDUCE_BLOCK;
+  size_t     last  = (job->end + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+  size_t     b0, stride, lo, hi;
+  owned_blocks(first, last, tid, threads, &b0, &stride, &lo, &hi);
+
+  // a contiguous share is one span, so the fast reduction takes a single partial per thread
+  size_t runs = stride == 1 && lo < hi ? 1 : hi - lo;
+  size_t span = stride == 1 ? hi - lo : 1;
+
+  job->changed[tid] = 0;
+  for(size_t j = 0; j < runs; ++j)
+    {
+      size_t b     = b0 + (lo + j) * stride;
+      size_t begin = b * REDUCE_BLOCK, end = (b + span) * REDUCE_BLOCK;
+      if(begin < job->begin) begin = job->begin;
+      if(end > job->end) end = job->end;
+      if(begin < end) job->changed[tid] += assign_span(begin, end, job->kl, job->sums);
+    }
+}
+
+// Resumable part of recluster_state: labels set.items[begin, end) against target_means and returns how many labels changed.
+// When sums is given, the coordinates of each point are added to its new cluster.
+// Large ranges are split between parallel_thread_count() threads. labels_count is left alone, callers publish the pass once every point has been visited.
+size_t kmeans_assign_range(size_t begin, size_t end, size_t kl, CentroidSums *sums)
+{
+  reserve_labels(set.count);
+  if(end > set.count) end = set.count;
+  if(begin >= end) return 0;
+  if(kl >= ASSIGN_BLOCKED_MIN_K) center_block_prepare(&range_block, target_means, kl);
+
+  size_t threads = kmeans_thread_count();
+  if(threads == 1 || end - begin < KMEANS_PARALLEL_MIN) return assign_span(begin, end, kl, sums);
+
+  // grow the block table here, the threads only write to it
+  if(sums) centroid_sums_reserve(sums, end);
+  AssignJob job = {begin, end, kl, sums, {0}};
+  parallel_run(threads, assign_task, &job);
+
+  size_t changed = 0;
+  for(size_t t = 0; t < threads; ++t) changed += job.changed[t];
+  return changed;
+}
+
+typedef struct
+{
+  Vector3 *items;
+  int     *labels;
+} PlaceJob;
+
+static void place_task(void *ctx, size_t tid, size_t threads)
+{
+  PlaceJob *job = ctx;
+  size_t    b0, stride, lo, hi;
+  owned_blocks(0, (set.count + REDUCE_BLOCK - 1) / REDUCE_BLOCK, tid, threads, &b0, &stride, &lo, &hi);
+  for(size_t j = lo; j < hi; ++j)
+    {
+      size_t begin = (b0 + j * stride) * REDUCE_BLOCK;
+      size_t end   = begin + REDUCE_BLOCK < set.count ? begin + REDUCE_BLOCK : set.count;
+      memcpy(&job->items[begin], &set.items[begin], (end - begin) * sizeof(Vector3));
+      for(size_t i = begin; i < end; ++i) job->labels[i] = i < labels_count ? labels[i] : -1;
+    }
+}
+
+// Moves set.items and labels to fresh mappings whose blocks are first written by threads of the node
+// that owns them (see numa.h). Call after the set was replaced; points appended later land wherever they are first written.
+void kmeans_place_set(void)
+{
+#ifdef __linux__
+  if(!numa_aware || set.count < KMEANS_PARALLEL_MIN) return;
+
+  // fresh mappings: no page exists before the copy, so each one lands on the node of the thread writing it first
+  PlaceJob job = {numa_alloc_pages(set.count * sizeof(Vector3)), numa_alloc_pages(set.count * sizeof(int))};
+  if(!job.items || !job.labels)
+    {
+      numa_free(job.items);
+      numa_free(job.labels);
+      return;
+    }
+  parallel_run(kmeans_thread_count(), place_task, &job);
+
+  numa_free(set.items);
+  numa_free(labels);
+  set.items       = job.items;
+  set.capacity    = set.count;
+  labels          = job.labels;
+  labels_capacity = set.count;
+  TraceLog(LOG_INFO, "NUMA: placed %zu points on %zu node(s)", set.count, numa_node_count());
+#endif
+}
+
+// Resumable part of regroup_clusters: writes set.items[begin, end) at the fill positions of their clusters in a second
+// set of per-cluster arrays, so a half-done regroup never touches what is drawn; kmeans_group_publish swaps them in.
+void kmeans_group_range(size_t begin, size_t end, size_t kl, size_t *fill)
+{
+  if(end > labels_count) end = labels_count;
+  for(size_t i = begin; i < end; ++i)
+    {
+      int c = labels[i];
+      if(c < 0 || c >= (int)kl) continue;
+      Samples3D *s = &regrouped[c];
+      if(fill[c] == s->capacity)
+        {
+          s->capacity = s->capacity ? s->capacity * 2 : 1;
+          s->items    = realloc(s->items, s->capacity * sizeof(Vector3));
+        }
+      s->items[fill[c]++] = set.items[i];
+    }
+}
+
+// Makes the grouping written by kmeans_group_range the drawn one; the previous arrays are reused by the next regroup
+void kmeans_group_publish(size_t kl, const size_t *fill)
+{
+  for(size_t i = 0; i < kl; ++i)
+    {
+      Samples3D drawn  = cluster[i];
+      cluster[i]       = regrouped[i];
+      cluster[i].count = fill[i];
+      regrouped[i]     = drawn;
+      online_counts[i] = fill[i];
+    }
+  current_k = kl;
+}
+
+// Sequential (MacQueen) k-means: each incoming point moves its nearest mean by 1/n of the difference.
+// Once the set holds `window` points, new points overwrite the oldest slot and the evicted point is
+// removed from its mean the same way, so target_means stay the means of the points currently in the window.
+// A set already larger than the window (e.g. generated data) is cut down to its first `window` points first.
+void kmeans_ingest(const Vector3 *points, size_t n, size_t k, size_t window)
+{
+  if(n == 0 || k == 0 || window == 0) return;
+  if(set.count > window)
+    {
+      set.count    = window;
+      online_head  = 0;
+      labels_count = 0;
+    }
+  if(labels_count != set.count || current_k != k)
+    {
+      // the sequential updates need target_means to be the exact means of the points they count,
+      // which random or stale means are not: label the set and restart from its means, every point counted once
+      recluster_state(k);
+      kmeans_weighted_means(set.items, NULL, labels, set.count, k, target_means, online_counts);
+    }
+
+  for(size_t i = 0; i < n; ++i)
+    {
+      Vector3 p = points[i];
+      int     c;
+      size_t  slot;
+      kmeans_assign(&p, 1, target_means, k, &c);
+      if(c < 0) continue; // no finite distance to any mean
+
+      if(set.count < window)
+        {
+          append_to_cluster(&set, p);
+          slot = set.count - 1;
+          reserve_labels(set.count);
+          labels_count = set.count;
+        }
+      else
+        {
+          slot = online_head++ % set.count;
+
+          int     o = labels[slot];
+          Vector3 y = set.items[slot];
+          if(o >= 0 && o < (int)k && online_counts[o] > 0)
             {
-              s = sm;
-              k = j;
+              online_counts[o] -= 1;
+              if(online_counts[o] > 0)
+                {
+                  Vector3 d       = Vector3Subtract(y, target_means[o]);
+                  target_means[o] = Vector3Subtract(target_means[o], Vector3Scale(d, 1.0f / online_counts[o]));
+                }
             }
+          set.items[slot] = p;
         }
-      if(k != -1) append_to_cluster(&cluster[k], p);
+
+      Vector3 d    = Vector3Subtract(p, target_means[c]);
+      labels[slot] = c;
+      online_counts[c] += 1;
+      target_means[c] = Vector3Add(target_means[c], Vector3Scale(d, 1.0f / online_counts[c]));
     }
-  current_k = kl;
 }
 
-static void update_means(float cluster_radius, size_t k)
+// Nearest centre of every point. Large batches against many centres go through assign_blocked.
+void kmeans_assign(const Vector3 *points, size_t n, const Vector3 *centers, size_t k, int *out)
+{
+  if(k >= ASSIGN_BLOCKED_MIN_K && n >= ASSIGN_TILE_POINTS)
+    {
+      CenterBlock b = {0};
+      center_block_prepare(&b, centers, k);
+      assign_blocked(&b, points, n, out);
+      center_block_free(&b);
+      return;
+    }
+  assign_direct(points, n, centers, k, out);
+}
+
+// Weighted centroid of every label in [0, k). Centres without mass are left untouched, their mass is 0.
+void kmeans_weighted_means(const Vector3 *points, const float *w, const int *lab, size_t n, size_t k, Vector3 *centers, double *mass)
+{
+  double (*sum)[4] = calloc(k, sizeof(*sum));
+  centroid_accumulate(points, w, lab, 0, n, k, sum);
+  for(size_t j = 0; j < k; ++j)
+    {
+      mass[j] = sum[j][3];
+      if(mass[j] > 0) centers[j] = (Vector3){(float)(sum[j][0] / mass[j]), (float)(sum[j][1] / mass[j]), (float)(sum[j][2] / mass[j])};
+    }
+  free(sum);
+}
+
+// Start animating towards the centroids given by sum, reseeding the clusters that ended up empty
+void apply_means(double (*sum)[4], float cluster_radius, size_t k)
 {
   SetRandomSeed(GetRandomValue(0, 10000));
   for(size_t i = 0; i < k; ++i)
     {
       old_means[i]  = means[i];          // Store old means for animation
       old_colors[i] = cluster_colors[i]; // Store old colors for animation
-      if(cluster[i].count > 0)
+      if(sum[i][3] > 0)
         {
-          target_means[i] = Vector3Zero();
-          for(size_t j = 0; j < cluster[i].count; ++j) { target_means[i] = Vector3Add(target_means[i], cluster[i].items[j]); }
-          target_means[i].x /= cluster[i].count;
-          target_means[i].y /= cluster[i].count;
-          target_means[i].z /= cluster[i].count;
+          target_means[i]  = (Vector3){(float)(sum[i][0] / sum[i][3]), (float)(sum[i][1] / sum[i][3]), (float)(sum[i][2] / sum[i][3])};
           target_colors[i] = colors[i % COLORS_COUNT]; // Assign new color
         }
       else
@@ -2,12 +2,23 @@
 #include "common.h"
 #define RLIGHTS_IMPLEMENTATION
 #include "rlights.h"
+#include "recorder.h"
+#include "picking.h"
+#include "spatial_sort.h"
+#include "coreset.h"
+#include "stream.h"
+#include "scheduler.h"
+#include "parallel.h"
+#include "numa.h"
+#include <string.h>
+#include <signal.h>
 #ifdef USE_NVIDIA_CARD
 __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
 #endif
 
 #define MAIN_BACKGROUND_COLOR                                                                                                                                  \
   (Color) { 20, 20, 20, 255 }
+#define PICK_REBUILD_INTERVAL 0.5 // seconds between picking grid rebuilds while points are streaming in
 
 static Samples3D set                     = {0};
 static Samples3D cluster[K_MAX]          = {0};
@@ -28,6 +39,26 @@ static bool      isKMeansAnimation       = false;
 static float     cube_rotation_angle     = 0.0f;
 static size_t    current_k               = 0;
 static int       selected_centroid_index = -1;
+static bool      recording               = false;
+static float     record_dt               = 0.0f;
+static PickGrid  pick_grid               = {0};
+static bool      pick_dirty              = true;
+static double    pick_time_us            = 0.0;
+static bool      spatial_ordering        = false;
+static double    sort_time_ms            = 0.0;
+static size_t    coreset_iterations      = 0;
+static double    coreset_build_ms        = 0.0;
+static double    coreset_solve_ms        = 0.0;
+static double    coreset_full_ms         = 0.0;
+static double    pick_built_at           = 0.0;
+static size_t    stream_window           = STREAM_DEFAULT_WINDOW;
+static Vector3   stream_batch[STREAM_MAX_PER_FRAME];
+
+static SpatialOrder      set_order = {0};
+static WeightedSamples3D coreset   = {0};
+static Scheduler         scheduler = {0};
+
+static PickResult hover = {0};
 
 static const float ANIMATION_DURATION         = 0.5f;
 static float       animation_time             = 0.0f;
@@ -49,102 +80,265 @@ void EventHandler(float *cluster_radius, float *camera_magnitude);
 void UpdateCameraPosition(float *cluster_radius, float *camera_magnitude);
 void DoAnimations(const float cluster_radius);
 void DrawAxis(Vector3 center, float length);
-
-int main()
+void SelectCentroid(int index, const float camera_magnitude);
+void RegenerateData(const float cluster_radius);
+void CoresetSolve(void);
+void ApplySpatialOrder(void);
+void UpdatePicking(void);
+void IngestStream(void);
+void DrawHover(int x, int y, int text_size);
+void DrawFrame(const float cluster_radius, const int screenHeight);
+float FrameDelta(void);
+
+// Set by SIGINT/SIGTERM: a hidden recording window cannot be closed, so this is how an open-ended --record ends
+static volatile sig_atomic_t stop_requested = 0;
+static void RequestStop(int sig) { stop_requested = 1; }
+
+int main(int argc, char **argv)
 {
-  const int   screenWidth      = 1280;
-  const int   screenHeight     = 720;
-  const char *title            = "K-means Clustering Visualization";
-  float       cluster_radius   = 50;
-  float       camera_magnitude = cluster_radius * 5;
+  const int    screenWidth      = 1280;
+  const int    screenHeight     = 720;
+  const char  *title            = "K-means Clustering Visualization";
+  float        cluster_radius   = 50;
+  float        camera_magnitude = cluster_radius * 5;
+  const char  *record_path      = NULL;
+  RecordFormat record_format    = RECORD_Y4M;
+  int          record_fps       = RECORDER_DEFAULT_FPS;
+  int          record_frames    = 0;
+  const char  *stream_path      = NULL;
+  const char  *seed             = NULL;
+
+  for(int i = 1; i < argc; ++i)
+    {
+      if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) { record_path = argv[++i]; }
+      else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc) { record_format = recorder_format_from_string(argv[++i]); }
+      else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc) { record_fps = atoi(argv[++i]); }
+      else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) { record_frames = atoi(argv[++i]); }
+      else if(strcmp(argv[i], "--stream") == 0 && i + 1 < argc) { stream_path = argv[++i]; }
+      else if(strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+        {
+          long window = atol(argv[++i]);
+          if(window < 1) { TraceLog(LOG_WARNING, "STREAM: ignoring --window %s, keeping %zu points", argv[i], stream_window); }
+          else { stream_window = (size_t)window; }
+        }
+      else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) { parallel_threads = (size_t)atol(argv[++i]); }
+      else if(strcmp(argv[i], "--deterministic") == 0) { deterministic_reduction = true; }
+      else if(strcmp(argv[i], "--numa") == 0) { numa_aware = true; }
+      else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) { seed = argv[++i]; }
+    }
 
-  SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT | FLAG_WINDOW_HIGHDPI | FLAG_WINDOW_MAXIMIZED);
+  if(record_path)
+    {
+      // offscreen: no vsync throttling, the window only carries the GL context
+      SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_HIDDEN);
+    }
+  else { SetConfigFlags(FLAG_MSAA_4X_HINT | FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT | FLAG_WINDOW_HIGHDPI | FLAG_WINDOW_MAXIMIZED); }
 
   InitWindow(screenWidth, screenHeight, title);
+  if(seed)
+    {
+      // InitWindow seeds raylib's generator from the clock; reseed both it and rand() for reproducible data and means
+      unsigned int value = (unsigned int)strtoul(seed, NULL, 10);
+      SetRandomSeed(value);
+      srand(value);
+    }
 
   InitCamera(camera_magnitude);
 
   randomize_means(k, cluster_radius * 2);
+  scheduler_init(&scheduler);
+
+  RenderTexture2D record_target = {0};
+  size_t          record_count  = 0;
+  if(record_path)
+    {
+      record_target = LoadRenderTexture(screenWidth, screenHeight);
+      recording     = recorder_start(record_path, record_format, screenWidth, screenHeight, record_fps);
+      record_dt     = 1.0f / (record_fps > 0 ? record_fps : RECORDER_DEFAULT_FPS);
+      if(!recording)
+        {
+          UnloadRenderTexture(record_target);
+          CloseWindow();
+          return 1;
+        }
+      if(!stream_path) RegenerateData(cluster_radius);
+      isKMeansAnimation = !stream_path;
+    }
+  if(stream_path && !stream_start(stream_path))
+    {
+      CloseWindow();
+      return 1;
+    }
 
   // Speed of light rotation
 
-  while(!WindowShouldClose())
+  signal(SIGINT, RequestStop);
+  signal(SIGTERM, RequestStop);
+  while(!WindowShouldClose() && !stop_requested)
     {
-      ClearBackground(MAIN_BACKGROUND_COLOR);
       EventHandler(&cluster_radius, &camera_magnitude);
+      IngestStream();
       UpdateCameraPosition(&cluster_radius, &camera_magnitude);
       DoAnimations(cluster_radius);
-      BeginDrawing();
 
-      BeginMode3D(camera);
+      if(recording)
+        {
+          BeginTextureMode(record_target);
+          DrawFrame(cluster_radius, screenHeight);
+          EndTextureMode();
+          recorder_submit(record_target);
+
+          RecordStats stats = recorder_stats();
+          BeginDrawing();
+          ClearBackground(MAIN_BACKGROUND_COLOR);
+          DrawText(TextFormat("Recording %zu frames (%zu written, %zu dropped)", stats.submitted, stats.written, stats.dropped), 10, 10, 10, WHITE);
+          EndDrawing();
+
+          if(record_frames > 0 && ++record_count >= (size_t)record_frames) break;
+        }
+      else
+        {
+          UpdatePicking();
+          BeginDrawing();
+          DrawFrame(cluster_radius, screenHeight);
+          EndDrawing();
+        }
+    }
+  if(recording)
+    {
+      recorder_stop();
+      UnloadRenderTexture(record_target);
+    }
+  pick_grid_free(&pick_grid);
+  spatial_order_free(&set_order);
+  coreset_free(&coreset);
+  scheduler_free(&scheduler);
+  stream_stop();
+  CloseWindow();
+  return 0;
+}
+
+// Fixed timestep while recording so the output does not depend on how fast frames are produced
+float FrameDelta(void) { return recording ? record_dt : GetFrameTime(); }
 
-      for(size_t i = 0; i < current_k; i++)
+void DrawFrame(const float cluster_radius, const int screenHeight)
+{
+  ClearBackground(MAIN_BACKGROUND_COLOR);
+
+  BeginMode3D(camera);
+
+  for(size_t i = 0; i < current_k; i++)
+    {
+      for(size_t j = 0; j < cluster[i].count; j++)
         {
-          for(size_t j = 0; j < cluster[i].count; j++)
-            {
-              Vector3 p = cluster[i].items[j];
-              Vector3 s = {2, 2, 2};
-              if(i == selected_centroid_index) { DrawCubeV(p, s, ColorAlpha(cluster_colors[i], 1)); }
-              else { DrawCubeV(p, s, cluster_colors[i]); }
-            }
-          if(i == selected_centroid_index) { DrawSphere(means[i], MEAN_SIZE * 4, WHITE); }
-          else { DrawSphere(means[i], MEAN_SIZE * 4, ColorAlpha(cluster_colors[i], 1)); }
+          Vector3 p = cluster[i].items[j];
+          Vector3 s = {2, 2, 2};
+          if(i == selected_centroid_index) { DrawCubeV(p, s, ColorAlpha(cluster_colors[i], 1)); }
+          else { DrawCubeV(p, s, cluster_colors[i]); }
         }
+      if(i == selected_centroid_index) { DrawSphere(means[i], MEAN_SIZE * 4, WHITE); }
+      else { DrawSphere(means[i], MEAN_SIZE * 4, ColorAlpha(cluster_colors[i], 1)); }
+    }
 
-      DrawAxis(Vector3Zero(), cluster_radius);
+  if(!recording && hover.hit && !hover.is_centroid) { DrawCubeWiresV(set.items[hover.index], (Vector3){2.2f, 2.2f, 2.2f}, WHITE); }
 
-      DrawSphere(light, 3, YELLOW);
+  DrawAxis(Vector3Zero(), cluster_radius);
 
-      DrawBoundingBox(
-        (BoundingBox){
-          (Vector3){-cluster_radius * 2, -cluster_radius * 2, -cluster_radius * 2},
-          (Vector3){cluster_radius * 2,  cluster_radius * 2,  cluster_radius * 2 }
-      },
-        WHITE);
+  DrawSphere(light, 3, YELLOW);
 
-      EndMode3D();
+  DrawBoundingBox(
+    (BoundingBox){
+      (Vector3){-cluster_radius * 2, -cluster_radius * 2, -cluster_radius * 2},
+      (Vector3){cluster_radius * 2,  cluster_radius * 2,  cluster_radius * 2 }
+  },
+    WHITE);
 
-      int current_text_y = 10;
-      int text_size      = 10;
-      int text_padding   = 10;
+  EndMode3D();
 
-      if(isKMeansAnimation) { DrawText("Press [SPACE] to pause Kmeans ", 10, current_text_y, text_size, WHITE); }
+  int current_text_y = 10;
+  int text_size      = 10;
+  int text_padding   = 10;
 
-      else { DrawText("Press [SPACE] to start Kmeans Clustering ", 10, current_text_y, text_size, WHITE); }
+  if(isKMeansAnimation) { DrawText("Press [SPACE] to pause Kmeans ", 10, current_text_y, text_size, WHITE); }
 
-      current_text_y += text_size + text_padding;
+  else { DrawText("Press [SPACE] to start Kmeans Clustering ", 10, current_text_y, text_size, WHITE); }
 
-      DrawText("Press [R] to generate new data", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
 
-      current_text_y += text_size + text_padding;
+  DrawText(TextFormat("Budget %.0f ms per frame, [-]/[=] to change: %zu iterations, %zu slices of %zu points this frame (%.2f ms, %.1f ns/point, %zu threads%s%s)",
+                      scheduler.budget_ms, scheduler.iterations, scheduler.slices, scheduler.slice[SCHED_ASSIGN], scheduler.used_ms, scheduler.ns_per_point[SCHED_ASSIGN],
+                      parallel_thread_count(), deterministic_reduction ? ", deterministic" : "",
+                      numa_aware ? TextFormat(", pinned on %zu NUMA nodes", numa_node_count()) : ""),
+           10, current_text_y, text_size, WHITE);
 
-      if(centroid_selected && selected_centroid_index != -1)
-        {
-          DrawText("Selected Centroid - press B to unselect ", -10, -70, 20, cluster_colors[selected_centroid_index]);
-        }
-      current_text_y += text_size + text_padding;
-      EndDrawing();
-      DrawText(TextFormat("K = %d press [A] for k - 1  or [Q] for k + 1", k), 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Press [W] to randomize means", 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Press [N] to select next centroid", 10, current_text_y, text_size,
-               centroid_selected ? ColorAlpha(cluster_colors[selected_centroid_index], 1) : WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Press [B] to unselect centroid", 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Press [G] to increase cluster radius", 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Press [H] to decrease cluster radius", 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Use mouse to rotate camera", 10, current_text_y, text_size, WHITE);
-      current_text_y += text_size + text_padding;
-      DrawText("Use mouse wheel to zoom in/out", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+
+  if(scheduler.converged) { DrawText(TextFormat("Converged after %zu iterations", scheduler.total_iterations), 10, current_text_y, text_size, WHITE); }
+  else
+    {
+      DrawText(TextFormat("Iteration %zu: %zu of %zu points %s, last iteration took %zu frames", scheduler.total_iterations + 1, scheduler.cursor, set.count,
+                          scheduler.phase == SCHED_ASSIGN ? "assigned" : "regrouped", scheduler.last_pass_frames),
+               10, current_text_y, text_size, WHITE);
+    }
+
+  current_text_y += text_size + text_padding;
+
+  DrawText("Press [R] to generate new data", 10, current_text_y, text_size, WHITE);
+
+  current_text_y += text_size + text_padding;
+
+  if(spatial_ordering) { DrawText(TextFormat("Press [M] to restore generation order (Morton sort took %.1f ms)", sort_time_ms), 10, current_text_y, text_size, WHITE); }
+  else { DrawText("Press [M] to sort points along a Morton curve", 10, current_text_y, text_size, WHITE); }
+
+  current_text_y += text_size + text_padding;
+
+  if(coreset.count > 0)
+    {
+      DrawText(TextFormat("Press [C] to solve on a coreset (%zu points: build %.1f ms, %zu iterations %.1f ms, full pass %.1f ms)", coreset.count,
+                          coreset_build_ms, coreset_iterations, coreset_solve_ms, coreset_full_ms),
+               10, current_text_y, text_size, WHITE);
+    }
+  else { DrawText("Press [C] to solve on a coreset", 10, current_text_y, text_size, WHITE); }
+
+  if(stream_active())
+    {
+      StreamStats stats = stream_stats();
       current_text_y += text_size + text_padding;
+      DrawText(TextFormat("Streaming: %zu points received, %zu in window of %zu, %zu lines rejected", stats.received, set.count, stream_window, stats.rejected), 10,
+               current_text_y, text_size, WHITE);
+    }
+
+  current_text_y += text_size + text_padding;
+
+  if(centroid_selected && selected_centroid_index != -1)
+    {
+      DrawText("Selected Centroid - press B to unselect ", -10, -70, 20, cluster_colors[selected_centroid_index]);
+    }
+  current_text_y += text_size + text_padding;
+  DrawText(TextFormat("K = %d press [A] for k - 1  or [Q] for k + 1", k), 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Press [W] to randomize means", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Press [N] to select next centroid", 10, current_text_y, text_size,
+           centroid_selected ? ColorAlpha(cluster_colors[selected_centroid_index], 1) : WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Press [B] to unselect centroid", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Press [G] to increase cluster radius", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Press [H] to decrease cluster radius", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Use mouse to rotate camera", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Use mouse wheel to zoom in/out", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  DrawText("Hover to inspect, right click to select a cluster", 10, current_text_y, text_size, WHITE);
+  current_text_y += text_size + text_padding;
+  if(!recording)
+    {
+      DrawHover(10, screenHeight - 60, text_size);
       DrawFPS(10, screenHeight - 20);
     }
-  CloseWindow();
-  return 0;
 }
 
 void InitCamera(const float camera_magnitude)
@@ -176,11 +370,13 @@ void EventHandler(float *cluster_radius, float *camera_magnitude)
       // if(isKMeansAnimation) isKMeansAnimation = false;
       if(k > K_MAX) k = K_MAX;
       randomize_means(k, *cluster_radius * 2);
+      scheduler_reset(&scheduler);
     }
   if(IsKeyPressed(KEY_W))
     {
       randomize_means(k, *cluster_radius * 2);
       recluster_state(k);
+      scheduler_reset(&scheduler);
     }
   if(IsKeyPressed(KEY_A))
     {
@@ -188,6 +384,7 @@ void EventHandler(float *cluster_radius, float *camera_magnitude)
       // if(isKMeansAnimation) isKMeansAnimation = false;
       if(k < 1) k = 1;
       randomize_means(k, *cluster_radius * 2);
+      scheduler_reset(&scheduler);
     }
   if(IsKeyPressed(KEY_B))
     {
@@ -195,28 +392,22 @@ void EventHandler(float *cluster_radius, float *camera_magnitude)
       selected_centroid_index = -1;
       camera.target           = Vector3Zero();
     }
-  if(IsKeyPressed(KEY_R))
+  if(IsKeyPressed(KEY_R)) { RegenerateData(*cluster_radius); }
+  if(IsKeyPressed(KEY_C)) { CoresetSolve(); }
+  if(IsKeyPressed(KEY_M) && !stream_active())
     {
-      generate_data(*cluster_radius, k);
-      recluster_state(k);
+      spatial_ordering = !spatial_ordering;
+      ApplySpatialOrder();
     }
-  if(IsKeyPressed(KEY_N))
+  if(IsKeyPressed(KEY_N)) { SelectCentroid((selected_centroid_index + 1) % k, *camera_magnitude); }
+  if(IsMouseButtonPressed(MOUSE_BUTTON_RIGHT) && hover.hit && current_k > 0)
     {
-      centroid_selected       = true;
-      selected_centroid_index = (selected_centroid_index + 1) % k;
-      camera_start_target     = camera.target;
-      camera_end_target       = means[selected_centroid_index];
-      camera_transition       = true;
-      camera_transition_time  = 0.0f;
-      camera_start_pos        = camera.position;
-      camera_end_pos          = (Vector3){
-                 .x = means[selected_centroid_index].x + sinf(camera_theta) * cosf(camera_phi) * *camera_magnitude,
-                 .y = means[selected_centroid_index].y + sinf(camera_phi) * *camera_magnitude,
-                 .z = means[selected_centroid_index].z + cosf(camera_theta) * cosf(camera_phi) * *camera_magnitude,
-      };
-      light = means[selected_centroid_index];
+      int index = hover.is_centroid ? (int)hover.index : hover.index < labels_count ? labels[hover.index] : -1;
+      if(index >= 0 && index < k) SelectCentroid(index, *camera_magnitude);
     }
   if(IsKeyPressed(KEY_SPACE)) { isKMeansAnimation = !isKMeansAnimation; }
+  if(IsKeyPressed(KEY_MINUS)) { scheduler.budget_ms = fmax(scheduler.budget_ms - 1, SCHED_MIN_BUDGET_MS); }
+  if(IsKeyPressed(KEY_EQUAL)) { scheduler.budget_ms = fmin(scheduler.budget_ms + 1, SCHED_MAX_BUDGET_MS); }
   if(IsMouseButtonDown(MOUSE_LEFT_BUTTON))
     {
       HideCursor();
@@ -232,7 +423,7 @@ void EventHandler(float *cluster_radius, float *camera_magnitude)
 
 void UpdateCameraPosition(float *cluster_radius, float *camera_magnitude)
 {
-  float deltaTime = GetFrameTime();
+  float deltaTime = FrameDelta();
   *camera_magnitude += camera_magnitude_vel * deltaTime;
   if(*camera_magnitude < 0) *camera_magnitude = 0;
   camera_magnitude_vel -= GetMouseWheelMove() * SAMPLE_SIZE * 5 * k;
@@ -254,10 +445,11 @@ void UpdateCameraPosition(float *cluster_radius, float *camera_magnitude)
       camera.target   = Vector3Lerp(camera_start_target, camera_end_target, t);
     }
 
-  if(isKMeansAnimation)
+  if(isKMeansAnimation) { scheduler_step(&scheduler, k, *cluster_radius); }
+
+  // follow the selected centroid whenever an iteration moved it
+  if(isKMeansAnimation && scheduler.iterations > 0 && selected_centroid_index >= 0)
     {
-      update_means(*cluster_radius, k);
-      recluster_state(k);
       camera_start_target = camera.target;
       camera_end_target   = means[selected_centroid_index];
       camera_start_pos    = camera.position;
@@ -272,7 +464,7 @@ void UpdateCameraPosition(float *cluster_radius, float *camera_magnitude)
 
 void DoAnimations(const float cluster_radius)
 {
-  float deltaTime = GetFrameTime();
+  float deltaTime = FrameDelta();
   animation_time += deltaTime;
   if(animation_time > ANIMATION_DURATION) animation_time = ANIMATION_DURATION;
   for(size_t i = 0; i < k; ++i)
@@ -287,6 +479,137 @@ void DoAnimations(const float cluster_radius)
   light.z = camera.target.z + (cluster_radius / 2) * sinf(light_rotation_angle * 0.5f); // Different axis rotation
 }
 
+void RegenerateData(const float cluster_radius)
+{
+  generate_data(cluster_radius, k);
+  spatial_order_reset(&set_order, set.count);
+  if(spatial_ordering) spatial_sort(&set, &set_order);
+  kmeans_place_set();
+  recluster_state(k);
+  scheduler_reset(&scheduler);
+  pick_dirty = true;
+}
+
+// Sort the current points along the Morton curve, or put them back in generation order;
+// labels follow the points, so recompute them with the same means
+void ApplySpatialOrder(void)
+{
+  double start = GetTime();
+  if(spatial_ordering) { spatial_sort(&set, &set_order); }
+  else if(!spatial_unsort(&set, &set_order)) { return; }
+  sort_time_ms = (GetTime() - start) * 1e3;
+  kmeans_place_set();
+  if(current_k > 0) recluster_state(current_k);
+  scheduler_reset(&scheduler);
+  pick_dirty = true;
+}
+
+// Cluster a small weighted summary of the set, then label the full set once with the result
+void CoresetSolve(void)
+{
+  if(set.count == 0) return;
+  size_t m = CORESET_SIZE_PER_K * k;
+  if(m < CORESET_MIN_SIZE) m = CORESET_MIN_SIZE;
+
+  double start = GetTime();
+  coreset_build(set.items, NULL, set.count, m, &coreset);
+  double built = GetTime();
+  coreset_iterations = coreset_kmeans(&coreset, target_means, k, CORESET_MAX_ITER);
+  double solved = GetTime();
+  for(size_t i = 0; i < k; ++i)
+    {
+      old_means[i]     = means[i];
+      old_colors[i]    = cluster_colors[i];
+      target_colors[i] = colors[i % COLORS_COUNT];
+    }
+  animation_time = 0.0f;
+  recluster_state(k);
+  scheduler_reset(&scheduler);
+
+  coreset_build_ms = (built - start) * 1e3;
+  coreset_solve_ms = (solved - built) * 1e3;
+  coreset_full_ms  = (GetTime() - solved) * 1e3;
+}
+
+void SelectCentroid(int index, const float camera_magnitude)
+{
+  centroid_selected       = true;
+  selected_centroid_index = index;
+  camera_start_target     = camera.target;
+  camera_end_target       = means[selected_centroid_index];
+  camera_transition       = true;
+  camera_transition_time  = 0.0f;
+  camera_start_pos        = camera.position;
+  camera_end_pos          = (Vector3){
+             .x = means[selected_centroid_index].x + sinf(camera_theta) * cosf(camera_phi) * camera_magnitude,
+             .y = means[selected_centroid_index].y + sinf(camera_phi) * camera_magnitude,
+             .z = means[selected_centroid_index].z + cosf(camera_theta) * cosf(camera_phi) * camera_magnitude,
+  };
+  light = means[selected_centroid_index];
+}
+
+// Feed queued points to the engine; the means move with every point and the cluster arrays are regrouped once per frame
+void IngestStream(void)
+{
+  size_t n = stream_poll(stream_batch, STREAM_MAX_PER_FRAME);
+  if(n == 0) return;
+  kmeans_ingest(stream_batch, n, k, stream_window);
+  regroup_clusters(k);
+  spatial_order_reset(&set_order, 0);
+  scheduler.converged = false; // keep the current pass going, new points are picked up as it reaches them
+  pick_dirty          = true;
+}
+
+void UpdatePicking(void)
+{
+  // the grid indexes positions only, so it is rebuilt when the point set changes, not when labels or means do.
+  // A streamed set changes every frame: rebuild periodically and read positions through the current array meanwhile.
+  double now = GetTime();
+  if(pick_dirty && (!stream_active() || pick_grid.count > set.count || now - pick_built_at > PICK_REBUILD_INTERVAL))
+    {
+      pick_grid_build(&pick_grid, set.items, set.count, 1.0f);
+      pick_dirty    = false;
+      pick_built_at = now;
+    }
+  pick_grid.items = set.items;
+  Ray    ray   = GetMouseRay(GetMousePosition(), camera);
+  double start = GetTime();
+  hover        = pick_ray(&pick_grid, ray, means, current_k, MEAN_SIZE * 4);
+  pick_time_us = (GetTime() - start) * 1e6;
+}
+
+void DrawHover(int x, int y, int text_size)
+{
+  if(!hover.hit || current_k == 0)
+    {
+      DrawText(TextFormat("Pick: %.1f us, right click a point or centroid to select its cluster", pick_time_us), x, y, text_size, WHITE);
+      return;
+    }
+  if(hover.is_centroid)
+    {
+      Vector3 m = means[hover.index];
+      DrawText(TextFormat("Centroid %zu (%.1f, %.1f, %.1f): %zu points", hover.index, m.x, m.y, m.z, cluster[hover.index].count), x, y, text_size,
+               ColorAlpha(cluster_colors[hover.index], 1));
+    }
+  else
+    {
+      Vector3 p        = set.items[hover.index];
+      int     c        = hover.index < labels_count ? labels[hover.index] : -1;
+      size_t  original = hover.index < set_order.count ? set_order.perm[hover.index] : hover.index;
+      if(c < 0 || c >= (int)current_k)
+        {
+          DrawText(TextFormat("Point %zu (%.1f, %.1f, %.1f): no cluster", original, p.x, p.y, p.z), x, y, text_size, WHITE);
+        }
+      else
+        {
+          DrawText(TextFormat("Point %zu (%.1f, %.1f, %.1f): cluster %d of %zu points, %.1f from centroid", original, p.x, p.y, p.z, c, cluster[c].count,
+                              Vector3Distance(p, means[c])),
+                   x, y, text_size, ColorAlpha(cluster_colors[c], 1));
+        }
+    }
+  DrawText(TextFormat("Pick: %.1f us", pick_time_us), x, y + text_size * 2, text_size, WHITE);
+}
+
 void DrawAxis(Vector3 center, float length)
 {
   DrawLine3D(center, (Vector3){center.x + length, center.y, center.z}, RED);
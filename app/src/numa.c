@@ -0,0 +1,169 @@
+#define _GNU_SOURCE // sched_getaffinity, mremap
+#include "numa.h"
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#define NUMA_MAX_CPUS    1024
+#define NUMA_MAX_REGIONS 16 // mapped buffers alive at once
+
+bool numa_aware = false;
+
+static struct
+{
+  bool   detected;
+  size_t nodes;
+  size_t cpu_count[NUMA_MAX_NODES];
+  int    cpus[NUMA_MAX_NODES][NUMA_MAX_CPUS];
+} topology = {0};
+
+static _Thread_local size_t current_node = 0;
+
+// buffers from numa_alloc_pages, so numa_realloc and numa_free can tell them from malloc memory (render thread only)
+static struct
+{
+  void  *p;
+  size_t bytes;
+} regions[NUMA_MAX_REGIONS] = {0};
+
+// "0-3,8-11" -> 0 1 2 3 8 9 10 11
+static size_t parse_cpulist(const char *s, int *out, size_t max)
+{
+  size_t n = 0;
+  while(*s && *s != '\n')
+    {
+      char *end;
+      long  lo = strtol(s, &end, 10), hi = lo;
+      if(end == s) break;
+      s = end;
+      if(*s == '-')
+        {
+          hi = strtol(s + 1, &end, 10);
+          s  = end;
+        }
+      for(long c = lo; c <= hi && n < max; ++c) out[n++] = (int)c;
+      if(*s == ',') s++;
+    }
+  return n;
+}
+
+static void detect(void)
+{
+  topology.detected = true;
+  topology.nodes    = 0;
+
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+  for(int id = 0; id < 4 * NUMA_MAX_NODES && topology.nodes < NUMA_MAX_NODES; ++id)
+    {
+      char path[64], line[4096];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+      FILE *f = fopen(path, "r");
+      if(!f) continue;
+      bool ok = fgets(line, sizeof(line), f) != NULL;
+      fclose(f);
+      if(!ok) continue;
+
+      // keep the cpus this process may use; memory-only nodes, or nodes outside our cpuset, have none
+      int   *cpus = topology.cpus[topology.nodes];
+      size_t all  = parse_cpulist(line, cpus, NUMA_MAX_CPUS), n = 0;
+      for(size_t c = 0; c < all; ++c)
+        if(!masked || (cpus[c] < CPU_SETSIZE && CPU_ISSET(cpus[c], &allowed))) cpus[n++] = cpus[c];
+      if(n == 0) continue;
+      topology.cpu_count[topology.nodes++] = n;
+    }
+#endif
+
+  if(topology.nodes == 0)
+    {
+      topology.nodes        = 1;
+      topology.cpu_count[0] = 0;
+#ifdef __linux__
+      for(int c = 0; masked && c < CPU_SETSIZE && topology.cpu_count[0] < NUMA_MAX_CPUS; ++c)
+        if(CPU_ISSET(c, &allowed)) topology.cpus[0][topology.cpu_count[0]++] = c;
+#endif
+    }
+  TraceLog(LOG_INFO, "NUMA: %zu node(s)", topology.nodes);
+}
+
+size_t numa_node_count(void)
+{
+  if(!topology.detected) detect();
+  return topology.nodes;
+}
+
+size_t numa_thread_node(size_t tid) { return tid % numa_node_count(); }
+
+int numa_thread_cpu(size_t tid)
+{
+  size_t node = numa_thread_node(tid);
+  if(topology.cpu_count[node] == 0) return -1;
+  return topology.cpus[node][(tid / topology.nodes) % topology.cpu_count[node]];
+}
+
+size_t numa_current_node(void) { return current_node; }
+
+void numa_set_current_node(size_t node) { current_node = node; }
+
+void *numa_alloc_pages(size_t bytes)
+{
+#ifdef __linux__
+  for(size_t r = 0; r < NUMA_MAX_REGIONS; ++r)
+    {
+      if(regions[r].p) continue;
+      void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(p == MAP_FAILED) return NULL;
+#ifdef MADV_NOHUGEPAGE
+      // a 2 MB huge page would land on one node and span dozens of blocks meant for the others; the flag stays on the
+      // mapping when numa_realloc grows it. Kernels without transparent huge pages reject it, which is fine
+      madvise(p, bytes, MADV_NOHUGEPAGE);
+#endif
+      regions[r].p     = p;
+      regions[r].bytes = bytes;
+      return p;
+    }
+#endif
+  return malloc(bytes);
+}
+
+static size_t find_region(void *p)
+{
+  for(size_t r = 0; p && r < NUMA_MAX_REGIONS; ++r)
+    if(regions[r].p == p) return r;
+  return NUMA_MAX_REGIONS;
+}
+
+// Grows in place where possible; pages already placed keep their node, new ones are placed by whoever touches them
+void *numa_realloc(void *p, size_t bytes)
+{
+  size_t r = find_region(p);
+  if(r == NUMA_MAX_REGIONS) return realloc(p, bytes);
+#ifdef __linux__
+  void *q = mremap(p, regions[r].bytes, bytes, MREMAP_MAYMOVE);
+  if(q == MAP_FAILED) return NULL;
+  regions[r].p     = q;
+  regions[r].bytes = bytes;
+  return q;
+#else
+  return NULL;
+#endif
+}
+
+void numa_free(void *p)
+{
+  size_t r = find_region(p);
+  if(r == NUMA_MAX_REGIONS)
+    {
+      free(p);
+      return;
+    }
+#ifdef __linux__
+  munmap(p, regions[r].bytes);
+#endif
+  regions[r].p = NULL;
+}
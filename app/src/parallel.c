@@ -0,0 +1,91 @@
+#define _GNU_SOURCE // pthread_setaffinity_np
+#include "parallel.h"
+#include "numa.h"
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <stdatomic.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+size_t parallel_threads = 0;
+
+static atomic_bool pin_warned = false;
+
+typedef struct
+{
+  ParallelTask task;
+  void        *ctx;
+  size_t       tid;
+  size_t       threads;
+} ParallelJob;
+
+static void *parallel_main(void *arg)
+{
+  ParallelJob *job = arg;
+#ifdef __linux__
+  int cpu = numa_aware ? numa_thread_cpu(job->tid) : -1;
+  if(cpu >= 0)
+    {
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      CPU_SET(cpu, &mask);
+      // the thread still runs, on any cpu; only its memory stops being local
+      if(pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0 && !atomic_exchange(&pin_warned, true))
+        {
+          TraceLog(LOG_WARNING, "NUMA: could not pin worker %zu to cpu %d, running unpinned", job->tid, cpu);
+        }
+    }
+#endif
+  numa_set_current_node(numa_aware ? numa_thread_node(job->tid) : 0);
+  job->task(job->ctx, job->tid, job->threads);
+  return NULL;
+}
+
+size_t parallel_thread_count(void)
+{
+  if(parallel_threads > PARALLEL_MAX_THREADS) parallel_threads = PARALLEL_MAX_THREADS;
+  if(parallel_threads > 0) return parallel_threads;
+  long n = 1;
+#ifdef _WIN32
+  const char *env = getenv("NUMBER_OF_PROCESSORS");
+  if(env) n = atol(env);
+#else
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if(n < 1) n = 1;
+  if(n > PARALLEL_MAX_THREADS) n = PARALLEL_MAX_THREADS;
+  parallel_threads = (size_t)n;
+  return parallel_threads;
+}
+
+void parallel_run(size_t threads, ParallelTask task, void *ctx)
+{
+  if(threads < 1) threads = 1;
+  if(threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+
+  pthread_t   workers[PARALLEL_MAX_THREADS];
+  ParallelJob jobs[PARALLEL_MAX_THREADS];
+
+  // pinned runs start tid 0 on a worker as well, the caller's own affinity is left alone
+  size_t first   = numa_aware ? 0 : 1;
+  size_t started = first;
+  for(size_t t = first; t < threads; ++t)
+    {
+      jobs[t] = (ParallelJob){task, ctx, t, threads};
+      if(pthread_create(&workers[t], NULL, parallel_main, &jobs[t]) != 0) break;
+      started++;
+    }
+  // if a thread could not be started, run its share here instead
+  for(size_t t = started; t < threads; ++t) task(ctx, t, threads);
+  if(first == 1) task(ctx, 0, threads);
+  for(size_t t = first; t < started; ++t) pthread_join(workers[t], NULL);
+}
+
+void parallel_range(size_t count, size_t tid, size_t threads, size_t *begin, size_t *end)
+{
+  *begin = count * tid / threads;
+  *end   = count * (tid + 1) / threads;
+}
@@ -0,0 +1,169 @@
+#include "picking.h"
+#include "float.h"
+
+static int cell_coord(const PickGrid *g, float v, float origin, int axis)
+{
+  int c = (int)((v - origin) / g->cell);
+  if(c < 0) c = 0;
+  if(c >= g->dim[axis]) c = g->dim[axis] - 1;
+  return c;
+}
+
+static size_t cell_id(const PickGrid *g, int x, int y, int z) { return ((size_t)z * g->dim[1] + y) * g->dim[0] + x; }
+
+// Runs body for every cell c overlapped by the box around p
+#define FOR_POINT_CELLS(g, p, body)                                                                                                                            \
+  {                                                                                                                                                            \
+    int x0 = cell_coord(g, p.x - g->radius, g->min.x, 0), x1 = cell_coord(g, p.x + g->radius, g->min.x, 0);                                                    \
+    int y0 = cell_coord(g, p.y - g->radius, g->min.y, 1), y1 = cell_coord(g, p.y + g->radius, g->min.y, 1);                                                    \
+    int z0 = cell_coord(g, p.z - g->radius, g->min.z, 2), z1 = cell_coord(g, p.z + g->radius, g->min.z, 2);                                                    \
+    for(int z = z0; z <= z1; ++z)                                                                                                                              \
+      for(int y = y0; y <= y1; ++y)                                                                                                                            \
+        for(int x = x0; x <= x1; ++x)                                                                                                                          \
+          {                                                                                                                                                    \
+            size_t c = cell_id(g, x, y, z);                                                                                                                    \
+            body;                                                                                                                                              \
+          }                                                                                                                                                    \
+  }
+
+void pick_grid_build(PickGrid *g, const Vector3 *items, size_t count, float radius)
+{
+  g->items  = items;
+  g->count  = count;
+  g->radius = radius;
+  if(count == 0) return;
+
+  Vector3 lo = items[0], hi = items[0];
+  for(size_t i = 1; i < count; ++i)
+    {
+      lo = Vector3Min(lo, items[i]);
+      hi = Vector3Max(hi, items[i]);
+    }
+  g->min      = Vector3Subtract(lo, (Vector3){radius, radius, radius});
+  Vector3 ext = Vector3Subtract(Vector3Add(hi, (Vector3){radius, radius, radius}), g->min);
+
+  // aim for PICK_POINTS_PER_CELL points per cell, but never cells smaller than a point
+  float volume = fmaxf(ext.x * ext.y * ext.z, FLT_MIN);
+  g->cell      = fmaxf(cbrtf(volume * PICK_POINTS_PER_CELL / count), radius * 2);
+  g->cell      = fmaxf(g->cell, fmaxf(ext.x, fmaxf(ext.y, ext.z)) / PICK_MAX_DIM);
+  g->dim[0]    = (int)(ext.x / g->cell) + 1;
+  g->dim[1]    = (int)(ext.y / g->cell) + 1;
+  g->dim[2]    = (int)(ext.z / g->cell) + 1;
+
+  size_t cells = (size_t)g->dim[0] * g->dim[1] * g->dim[2];
+  if(g->cell_capacity < cells + 1)
+    {
+      g->cell_capacity = cells + 1;
+      g->cell_start    = realloc(g->cell_start, g->cell_capacity * sizeof(size_t));
+    }
+  for(size_t c = 0; c <= cells; ++c) g->cell_start[c] = 0;
+
+  // counting sort: count, prefix sum, scatter
+  for(size_t i = 0; i < count; ++i) FOR_POINT_CELLS(g, items[i], g->cell_start[c + 1]++);
+  for(size_t c = 0; c < cells; ++c) g->cell_start[c + 1] += g->cell_start[c];
+
+  size_t total = g->cell_start[cells];
+  if(g->index_capacity < total)
+    {
+      g->index_capacity = total;
+      g->indices        = realloc(g->indices, g->index_capacity * sizeof(size_t));
+    }
+  for(size_t i = 0; i < count; ++i) FOR_POINT_CELLS(g, items[i], g->indices[g->cell_start[c]++] = i);
+
+  // scatter advanced each start to the next cell's start, shift back
+  for(size_t c = cells; c > 0; --c) g->cell_start[c] = g->cell_start[c - 1];
+  g->cell_start[0] = 0;
+}
+
+void pick_grid_free(PickGrid *g)
+{
+  free(g->cell_start);
+  free(g->indices);
+  *g = (PickGrid){0};
+}
+
+// Slab test, returns the entry distance or -1 on a miss. t_exit receives the exit distance.
+static float ray_box(Vector3 o, Vector3 inv, Vector3 lo, Vector3 hi, float *t_exit)
+{
+  float tx0 = (lo.x - o.x) * inv.x, tx1 = (hi.x - o.x) * inv.x;
+  float ty0 = (lo.y - o.y) * inv.y, ty1 = (hi.y - o.y) * inv.y;
+  float tz0 = (lo.z - o.z) * inv.z, tz1 = (hi.z - o.z) * inv.z;
+  float tmin = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)), fmaxf(fminf(tz0, tz1), 0.0f));
+  float tmax = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)), fmaxf(tz0, tz1));
+  if(t_exit) *t_exit = tmax;
+  return tmin <= tmax ? tmin : -1.0f;
+}
+
+static float ray_sphere(Ray ray, Vector3 center, float radius)
+{
+  Vector3 oc   = Vector3Subtract(ray.position, center);
+  float   b    = Vector3DotProduct(oc, ray.direction);
+  float   c    = Vector3DotProduct(oc, oc) - radius * radius;
+  float   disc = b * b - c;
+  if(disc < 0) return -1.0f;
+  float t = -b - sqrtf(disc);
+  if(t < 0) t = -b + sqrtf(disc);
+  return t;
+}
+
+PickResult pick_ray(const PickGrid *g, Ray ray, const Vector3 *centers, size_t k, float center_radius)
+{
+  PickResult best = {.hit = false, .distance = FLT_MAX};
+
+  for(size_t i = 0; i < k; ++i)
+    {
+      float t = ray_sphere(ray, centers[i], center_radius);
+      if(t >= 0 && t < best.distance) best = (PickResult){true, true, i, t};
+    }
+
+  if(g->count == 0 || g->cell_start == NULL) return best;
+
+  Vector3 o   = ray.position;
+  Vector3 d   = ray.direction;
+  Vector3 inv = {1.0f / d.x, 1.0f / d.y, 1.0f / d.z};
+  Vector3 r   = {g->radius, g->radius, g->radius};
+  Vector3 hi  = {g->min.x + g->dim[0] * g->cell, g->min.y + g->dim[1] * g->cell, g->min.z + g->dim[2] * g->cell};
+
+  float t_end;
+  float t = ray_box(o, inv, g->min, hi, &t_end);
+  if(t < 0 || t > best.distance) return best;
+
+  Vector3 p      = Vector3Add(o, Vector3Scale(d, t));
+  int     c[3]   = {cell_coord(g, p.x, g->min.x, 0), cell_coord(g, p.y, g->min.y, 1), cell_coord(g, p.z, g->min.z, 2)};
+  float   dir[3] = {d.x, d.y, d.z};
+  float   org[3] = {o.x, o.y, o.z};
+  float   lo[3]  = {g->min.x, g->min.y, g->min.z};
+  int     step[3];
+  float   t_max[3], t_delta[3];
+
+  for(int a = 0; a < 3; ++a)
+    {
+      step[a]    = dir[a] >= 0 ? 1 : -1;
+      t_delta[a] = dir[a] != 0 ? fabsf(g->cell / dir[a]) : FLT_MAX;
+      float edge = lo[a] + (c[a] + (step[a] > 0)) * g->cell;
+      t_max[a]   = dir[a] != 0 ? (edge - org[a]) / dir[a] : FLT_MAX;
+    }
+
+  for(;;)
+    {
+      size_t cell = cell_id(g, c[0], c[1], c[2]);
+      for(size_t j = g->cell_start[cell]; j < g->cell_start[cell + 1]; ++j)
+        {
+          size_t  i  = g->indices[j];
+          Vector3 q  = g->items[i];
+          float   th = ray_box(o, inv, Vector3Subtract(q, r), Vector3Add(q, r), NULL);
+          if(th >= 0 && th < best.distance) best = (PickResult){true, false, i, th};
+        }
+
+      int   a      = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+      float t_next = t_max[a];
+      // nothing in a later cell can be closer than a hit inside this one
+      if(best.distance <= t_next || t_next > t_end) break;
+
+      c[a] += step[a];
+      if(c[a] < 0 || c[a] >= g->dim[a]) break;
+      t_max[a] += t_delta[a];
+    }
+
+  return best;
+}
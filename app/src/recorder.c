@@ -0,0 +1,308 @@
+#include "recorder.h"
+#include <string.h>
+#include <pthread.h>
+#include <rlgl.h>
+
+// Asynchronous readback needs pixel buffer objects and fences (GL 3.2).
+// libGL exports them directly on Linux, which is also where the headless software GL runs;
+// other platforms use raylib's synchronous texture readback and only the encoding is threaded.
+#if defined(__linux__) && !defined(RECORDER_NO_PBO)
+#define RECORDER_USE_PBO
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+typedef struct
+{
+  unsigned char *pixels; // RGBA, bottom row first as read from the framebuffer
+} RecordSlot;
+
+static struct
+{
+  bool         active;
+  RecordFormat format;
+  char         path[512];
+  FILE        *file;
+  int          width;
+  int          height;
+  int          fps;
+  size_t       frame_size;
+
+  RecordSlot      ring[RECORDER_RING_SIZE];
+  size_t          head; // slots filled by the render thread
+  size_t          tail; // slots consumed by the writer thread
+  bool            stopping;
+  pthread_t       writer;
+  pthread_mutex_t lock;
+  pthread_cond_t  ready;
+
+  RecordStats stats;
+
+#ifdef RECORDER_USE_PBO
+  GLuint pbo[RECORDER_PBO_COUNT];
+  GLsync fence[RECORDER_PBO_COUNT];
+  size_t pbo_oldest;
+  size_t pbo_pending;
+#endif
+} rec = {0};
+
+// Copy a finished frame into the writer ring, dropping it if the writer is RECORDER_RING_SIZE frames behind.
+static void enqueue_pixels(const unsigned char *pixels)
+{
+  pthread_mutex_lock(&rec.lock);
+  bool full = rec.head - rec.tail == RECORDER_RING_SIZE;
+  pthread_mutex_unlock(&rec.lock);
+
+  if(full)
+    {
+      rec.stats.dropped++;
+      return;
+    }
+
+  // the slot at head is invisible to the writer until head is advanced
+  memcpy(rec.ring[rec.head % RECORDER_RING_SIZE].pixels, pixels, rec.frame_size);
+
+  pthread_mutex_lock(&rec.lock);
+  rec.head++;
+  pthread_cond_signal(&rec.ready);
+  pthread_mutex_unlock(&rec.lock);
+}
+
+#ifdef RECORDER_USE_PBO
+// Retire readbacks in submission order. Without wait, stops at the first one the GPU has not finished.
+static void collect_readbacks(bool wait)
+{
+  while(rec.pbo_pending > 0)
+    {
+      size_t i      = rec.pbo_oldest % RECORDER_PBO_COUNT;
+      GLenum status = glClientWaitSync(rec.fence[i], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+      if(status == GL_TIMEOUT_EXPIRED) return;
+      glDeleteSync(rec.fence[i]);
+
+      if(status == GL_WAIT_FAILED) { rec.stats.dropped++; }
+      else
+        {
+          glBindBuffer(GL_PIXEL_PACK_BUFFER, rec.pbo[i]);
+          const unsigned char *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rec.frame_size, GL_MAP_READ_BIT);
+          if(pixels)
+            {
+              enqueue_pixels(pixels);
+              glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+          else { rec.stats.dropped++; }
+          glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+      rec.pbo_oldest++;
+      rec.pbo_pending--;
+    }
+}
+#endif
+
+// BT.601 limited range, full resolution chroma (C444)
+static void write_y4m(const unsigned char *pixels, unsigned char *planes)
+{
+  size_t         plane = (size_t)rec.width * rec.height;
+  unsigned char *py    = planes;
+  unsigned char *pu    = planes + plane;
+  unsigned char *pv    = planes + plane * 2;
+
+  for(int y = 0; y < rec.height; ++y)
+    {
+      const unsigned char *row = pixels + (size_t)(rec.height - 1 - y) * rec.width * 4;
+      for(int x = 0; x < rec.width; ++x)
+        {
+          int r = row[x * 4 + 0];
+          int g = row[x * 4 + 1];
+          int b = row[x * 4 + 2];
+          *py++ = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+          *pu++ = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+          *pv++ = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+  fputs("FRAME\n", rec.file);
+  fwrite(planes, 1, plane * 3, rec.file);
+}
+
+static void flip_rows(const unsigned char *pixels, unsigned char *out)
+{
+  size_t stride = (size_t)rec.width * 4;
+  for(int y = 0; y < rec.height; ++y) { memcpy(out + (size_t)y * stride, pixels + (size_t)(rec.height - 1 - y) * stride, stride); }
+}
+
+static void write_frame(const unsigned char *pixels, unsigned char *scratch, size_t index)
+{
+  switch(rec.format)
+    {
+    case RECORD_Y4M: write_y4m(pixels, scratch); break;
+    case RECORD_RAW:
+      flip_rows(pixels, scratch);
+      fwrite(scratch, 1, rec.frame_size, rec.file);
+      break;
+    case RECORD_PNG:
+      {
+        char name[sizeof(rec.path) + 16];
+        flip_rows(pixels, scratch);
+        snprintf(name, sizeof(name), "%s_%06zu.png", rec.path, index);
+        ExportImage((Image){scratch, rec.width, rec.height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8}, name);
+      }
+      break;
+    }
+}
+
+static void *writer_main(void *arg)
+{
+  (void)arg;
+  unsigned char *scratch = malloc(rec.frame_size);
+
+  for(;;)
+    {
+      pthread_mutex_lock(&rec.lock);
+      while(rec.tail == rec.head && !rec.stopping) pthread_cond_wait(&rec.ready, &rec.lock);
+      if(rec.tail == rec.head)
+        {
+          pthread_mutex_unlock(&rec.lock);
+          break;
+        }
+      RecordSlot *slot  = &rec.ring[rec.tail % RECORDER_RING_SIZE];
+      size_t      index = rec.stats.written;
+      pthread_mutex_unlock(&rec.lock);
+
+      write_frame(slot->pixels, scratch, index);
+
+      pthread_mutex_lock(&rec.lock);
+      rec.tail++;
+      rec.stats.written++;
+      pthread_mutex_unlock(&rec.lock);
+    }
+
+  free(scratch);
+  return NULL;
+}
+
+RecordFormat recorder_format_from_string(const char *name)
+{
+  if(strcmp(name, "raw") == 0) return RECORD_RAW;
+  if(strcmp(name, "png") == 0) return RECORD_PNG;
+  return RECORD_Y4M;
+}
+
+bool recorder_start(const char *path, RecordFormat format, int width, int height, int fps)
+{
+  if(rec.active) return false;
+
+  rec.format     = format;
+  rec.width      = width;
+  rec.height     = height;
+  rec.fps        = fps > 0 ? fps : RECORDER_DEFAULT_FPS;
+  rec.frame_size = (size_t)width * height * 4;
+  rec.head       = 0;
+  rec.tail       = 0;
+  rec.stopping   = false;
+  rec.stats      = (RecordStats){0};
+  snprintf(rec.path, sizeof(rec.path), "%s", path);
+
+  rec.file = NULL;
+  if(format != RECORD_PNG)
+    {
+      rec.file = fopen(path, "wb");
+      if(!rec.file)
+        {
+          TraceLog(LOG_ERROR, "RECORDER: could not open %s", path);
+          return false;
+        }
+      if(format == RECORD_Y4M) fprintf(rec.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, rec.fps);
+    }
+
+  for(size_t i = 0; i < RECORDER_RING_SIZE; ++i) { rec.ring[i].pixels = malloc(rec.frame_size); }
+
+#ifdef RECORDER_USE_PBO
+  glGenBuffers(RECORDER_PBO_COUNT, rec.pbo);
+  for(size_t i = 0; i < RECORDER_PBO_COUNT; ++i)
+    {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, rec.pbo[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, rec.frame_size, NULL, GL_STREAM_READ);
+    }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  rec.pbo_oldest  = 0;
+  rec.pbo_pending = 0;
+#endif
+
+  pthread_mutex_init(&rec.lock, NULL);
+  pthread_cond_init(&rec.ready, NULL);
+  pthread_create(&rec.writer, NULL, writer_main, NULL);
+
+  rec.active = true;
+  TraceLog(LOG_INFO, "RECORDER: writing %dx%d @ %d fps to %s", width, height, rec.fps, path);
+  return true;
+}
+
+void recorder_submit(RenderTexture2D target)
+{
+  if(!rec.active) return;
+  rec.stats.submitted++;
+
+#ifdef RECORDER_USE_PBO
+  collect_readbacks(false);
+  if(rec.pbo_pending == RECORDER_PBO_COUNT)
+    {
+      rec.stats.dropped++;
+      return;
+    }
+  size_t i = (rec.pbo_oldest + rec.pbo_pending) % RECORDER_PBO_COUNT;
+  rlEnableFramebuffer(target.id);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, rec.pbo[i]);
+  glReadPixels(0, 0, rec.width, rec.height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  rlDisableFramebuffer();
+  rec.fence[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  rec.pbo_pending++;
+#else
+  unsigned char *pixels = rlReadTexturePixels(target.texture.id, rec.width, rec.height, target.texture.format);
+  if(pixels)
+    {
+      enqueue_pixels(pixels);
+      MemFree(pixels);
+    }
+#endif
+}
+
+void recorder_stop(void)
+{
+  if(!rec.active) return;
+
+#ifdef RECORDER_USE_PBO
+  collect_readbacks(true);
+  glDeleteBuffers(RECORDER_PBO_COUNT, rec.pbo);
+#endif
+
+  pthread_mutex_lock(&rec.lock);
+  rec.stopping = true;
+  pthread_cond_signal(&rec.ready);
+  pthread_mutex_unlock(&rec.lock);
+  pthread_join(rec.writer, NULL);
+
+  pthread_cond_destroy(&rec.ready);
+  pthread_mutex_destroy(&rec.lock);
+  for(size_t i = 0; i < RECORDER_RING_SIZE; ++i)
+    {
+      free(rec.ring[i].pixels);
+      rec.ring[i].pixels = NULL;
+    }
+  if(rec.file) fclose(rec.file);
+  rec.file   = NULL;
+  rec.active = false;
+
+  TraceLog(LOG_INFO, "RECORDER: %zu frames written, %zu dropped", rec.stats.written, rec.stats.dropped);
+}
+
+bool recorder_active(void) { return rec.active; }
+
+RecordStats recorder_stats(void)
+{
+  if(!rec.active) return rec.stats;
+  pthread_mutex_lock(&rec.lock);
+  RecordStats s = rec.stats;
+  pthread_mutex_unlock(&rec.lock);
+  return s;
+}
@@ -0,0 +1,118 @@
+#include "reduce.h"
+#include <pthread.h>
+#include <string.h>
+
+bool deterministic_reduction = false;
+
+static pthread_mutex_t reduce_lock[NUMA_MAX_NODES];
+static pthread_once_t  reduce_once = PTHREAD_ONCE_INIT;
+
+static void init_locks(void)
+{
+  for(size_t n = 0; n < NUMA_MAX_NODES; ++n) pthread_mutex_init(&reduce_lock[n], NULL);
+}
+
+static void reserve_blocks(CentroidSums *r, size_t blocks)
+{
+  if(blocks <= r->block_capacity) return;
+  size_t capacity = r->block_capacity * 2 > blocks ? r->block_capacity * 2 : blocks;
+  r->blocks       = realloc(r->blocks, capacity * K_MAX * sizeof(*r->blocks));
+  memset(&r->blocks[r->block_capacity * K_MAX], 0, (capacity - r->block_capacity) * K_MAX * sizeof(*r->blocks));
+  r->block_capacity = capacity;
+}
+
+// Sizes the block table for `count` points; single threaded, before any centroid_sums_add of the pass
+void centroid_sums_begin(CentroidSums *r, size_t count, size_t k)
+{
+  r->deterministic = deterministic_reduction;
+  r->k             = k;
+  memset(r->sum, 0, numa_node_count() * sizeof(r->sum[0]));
+  pthread_once(&reduce_once, init_locks);
+  if(!r->deterministic) return;
+
+  size_t blocks = (count + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+  reserve_blocks(r, blocks);
+  if(r->block_count) memset(r->blocks, 0, r->block_count * K_MAX * sizeof(*r->blocks));
+  r->block_count = blocks;
+}
+
+void centroid_accumulate(const Vector3 *points, const float *w, const int *lab, size_t begin, size_t end, size_t k, double (*sum)[4])
+{
+  for(size_t i = begin; i < end; ++i)
+    {
+      int c = lab[i];
+      if(c < 0 || c >= (int)k) continue;
+      double wi = w ? w[i] : 1.0;
+      sum[c][0] += wi * points[i].x;
+      sum[c][1] += wi * points[i].y;
+      sum[c][2] += wi * points[i].z;
+      sum[c][3] += wi;
+    }
+}
+
+// Makes room for `count` points when the set grew since centroid_sums_begin (streaming)
+void centroid_sums_reserve(CentroidSums *r, size_t count)
+{
+  size_t blocks = (count + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+  if(!r->deterministic || blocks <= r->block_count) return;
+  reserve_blocks(r, blocks);
+  r->block_count = blocks;
+}
+
+// Adds points[begin, end), indices into the whole set. Safe to call from several threads at once as long as,
+// in deterministic mode, no two concurrent ranges share a block and centroid_sums_reserve already covered them.
+void centroid_sums_add(CentroidSums *r, const Vector3 *points, const float *w, const int *lab, size_t begin, size_t end)
+{
+  if(begin >= end) return;
+  if(!r->deterministic)
+    {
+      // the partial only ever meets the other threads of its node
+      double partial[K_MAX][4] = {0};
+      size_t node              = numa_current_node();
+      centroid_accumulate(points, w, lab, begin, end, r->k, partial);
+      pthread_mutex_lock(&reduce_lock[node]);
+      for(size_t c = 0; c < r->k; ++c)
+        for(size_t j = 0; j < 4; ++j) r->sum[node][c][j] += partial[c][j];
+      pthread_mutex_unlock(&reduce_lock[node]);
+      return;
+    }
+
+  centroid_sums_reserve(r, end);
+  for(size_t b = begin / REDUCE_BLOCK; b * REDUCE_BLOCK < end; ++b)
+    {
+      size_t lo = b * REDUCE_BLOCK > begin ? b * REDUCE_BLOCK : begin;
+      size_t hi = (b + 1) * REDUCE_BLOCK < end ? (b + 1) * REDUCE_BLOCK : end;
+      centroid_accumulate(points, w, lab, lo, hi, r->k, &r->blocks[b * K_MAX]);
+    }
+}
+
+void centroid_sums_finish(CentroidSums *r, double (*sum)[4])
+{
+  if(!r->deterministic)
+    {
+      memcpy(sum, r->sum[0], r->k * sizeof(*r->sum[0]));
+      for(size_t node = 1; node < numa_node_count(); ++node)
+        for(size_t c = 0; c < r->k; ++c)
+          for(size_t j = 0; j < 4; ++j) sum[c][j] += r->sum[node][c][j];
+      return;
+    }
+
+  // pairwise tree over the blocks: block b takes b + stride at every level, the shape only depends on block_count
+  for(size_t stride = 1; stride < r->block_count; stride *= 2)
+    for(size_t b = 0; b + stride < r->block_count; b += 2 * stride)
+      {
+        double (*dst)[4] = &r->blocks[b * K_MAX];
+        double (*src)[4] = &r->blocks[(b + stride) * K_MAX];
+        for(size_t c = 0; c < r->k; ++c)
+          for(size_t j = 0; j < 4; ++j) dst[c][j] += src[c][j];
+      }
+
+  if(r->block_count) memcpy(sum, r->blocks, r->k * sizeof(*r->blocks));
+  else memset(sum, 0, r->k * sizeof(*r->blocks));
+}
+
+void centroid_sums_free(CentroidSums *r)
+{
+  free(r->blocks);
+  *r = (CentroidSums){0};
+}
@@ -0,0 +1,107 @@
+#include "scheduler.h"
+#include "kmeans.h"
+#include <string.h>
+
+void scheduler_init(Scheduler *s)
+{
+  *s                     = (Scheduler){0};
+  s->budget_ms           = SCHED_DEFAULT_BUDGET_MS;
+  s->slice[SCHED_ASSIGN] = SCHED_MIN_SLICE;
+  s->slice[SCHED_GROUP]  = SCHED_MIN_SLICE;
+  s->fresh               = true;
+  centroid_sums_begin(&s->sums, 0, K_MAX);
+}
+
+// Restart from the first point, e.g. after the data or the means changed outside the scheduler
+void scheduler_reset(Scheduler *s)
+{
+  s->phase       = SCHED_ASSIGN;
+  s->cursor      = 0;
+  s->changed     = 0;
+  s->converged   = false;
+  s->fresh       = true;
+  s->pass_frames = 0;
+  centroid_sums_begin(&s->sums, set.count, K_MAX);
+}
+
+void scheduler_free(Scheduler *s) { centroid_sums_free(&s->sums); }
+
+// Every point has a label for the current means: publish them and move the means, or stop if nothing changed
+static void finish_assign(Scheduler *s, size_t k, float cluster_radius)
+{
+  labels_count = set.count;
+  if(s->changed == 0 && !s->fresh) { s->converged = true; }
+  else
+    {
+      s->fresh = false;
+      double sum[K_MAX][4] = {0};
+      centroid_sums_finish(&s->sums, sum);
+      apply_means(sum, cluster_radius, k);
+      memset(s->fill, 0, sizeof(s->fill));
+      s->phase = SCHED_GROUP;
+    }
+  centroid_sums_begin(&s->sums, set.count, k);
+  s->cursor  = 0;
+  s->changed = 0;
+}
+
+// The cluster arrays hold the new grouping: publish their sizes, which completes the iteration
+static void finish_group(Scheduler *s, size_t k)
+{
+  kmeans_group_publish(k, s->fill);
+
+  s->iterations++;
+  s->total_iterations++;
+  s->last_pass_frames = s->pass_frames;
+  s->pass_frames      = 0;
+  s->phase            = SCHED_ASSIGN;
+  s->cursor           = 0;
+}
+
+void scheduler_step(Scheduler *s, size_t k, float cluster_radius)
+{
+  double start    = GetTime();
+  double deadline = start + s->budget_ms * 1e-3;
+
+  s->iterations = 0;
+  s->slices     = 0;
+  if(s->converged || set.count == 0)
+    {
+      s->used_ms = 0;
+      return;
+    }
+  s->pass_frames++;
+
+  do
+    {
+      SchedPhase phase = s->phase;
+      size_t     count = phase == SCHED_ASSIGN ? set.count : labels_count;
+      if(s->cursor >= count)
+        {
+          if(phase == SCHED_ASSIGN) finish_assign(s, k, cluster_radius);
+          else finish_group(s, k);
+          if(s->converged) break;
+          continue;
+        }
+
+      size_t n = s->slice[phase];
+      if(n > count - s->cursor) n = count - s->cursor;
+
+      double t0 = GetTime();
+      if(phase == SCHED_ASSIGN) { s->changed += kmeans_assign_range(s->cursor, s->cursor + n, k, &s->sums); }
+      else { kmeans_group_range(s->cursor, s->cursor + n, k, s->fill); }
+      double dt = GetTime() - t0;
+      s->cursor += n;
+      s->slices++;
+
+      // size the next slice of this phase to what is left of the budget
+      double cost            = dt * 1e9 / n;
+      s->ns_per_point[phase] = s->ns_per_point[phase] > 0 ? 0.8 * s->ns_per_point[phase] + 0.2 * cost : cost;
+      double left_ns         = (deadline - GetTime()) * 1e9 * SCHED_HEADROOM;
+      size_t fit             = left_ns > 0 ? (size_t)(left_ns / s->ns_per_point[phase]) : 0;
+      s->slice[phase]        = fit > SCHED_MIN_SLICE ? fit : SCHED_MIN_SLICE;
+    }
+  while(GetTime() < deadline);
+
+  s->used_ms = (GetTime() - start) * 1e3;
+}
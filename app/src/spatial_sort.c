@@ -0,0 +1,197 @@
+#include "spatial_sort.h"
+#include "parallel.h"
+#include "numa.h"
+#include <stdint.h>
+
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+#define RADIX_PASSES  ((3 * MORTON_BITS + RADIX_BITS - 1) / RADIX_BITS)
+
+typedef struct
+{
+  const Vector3 *items;
+  size_t         count;
+  Vector3        min;
+  Vector3        scale;
+
+  uint32_t *keys[2];
+  size_t   *index[2];
+  size_t   *histogram; // threads x RADIX_BUCKETS
+  int       shift;
+  int       src;
+
+  const size_t *old_perm;
+  size_t       *new_perm;
+  Vector3      *sorted;
+} SortJob;
+
+// Spread the low 10 bits of v so there are two zero bits between each of them
+static uint32_t spread_bits(uint32_t v)
+{
+  v &= 0x3ff;
+  v = (v | (v << 16)) & 0x030000ff;
+  v = (v | (v << 8)) & 0x0300f00f;
+  v = (v | (v << 4)) & 0x030c30c3;
+  v = (v | (v << 2)) & 0x09249249;
+  return v;
+}
+
+static uint32_t quantize(float v, float min, float scale)
+{
+  float q = (v - min) * scale;
+  if(q < 0) q = 0;
+  if(q > (1 << MORTON_BITS) - 1) q = (1 << MORTON_BITS) - 1;
+  return (uint32_t)q;
+}
+
+static void compute_keys(void *ctx, size_t tid, size_t threads)
+{
+  SortJob *job = ctx;
+  size_t   begin, end;
+  parallel_range(job->count, tid, threads, &begin, &end);
+  for(size_t i = begin; i < end; ++i)
+    {
+      Vector3 p = job->items[i];
+      job->keys[0][i] =
+        spread_bits(quantize(p.x, job->min.x, job->scale.x)) | (spread_bits(quantize(p.y, job->min.y, job->scale.y)) << 1) |
+        (spread_bits(quantize(p.z, job->min.z, job->scale.z)) << 2);
+      job->index[0][i] = i;
+    }
+}
+
+static void count_digits(void *ctx, size_t tid, size_t threads)
+{
+  SortJob  *job  = ctx;
+  size_t   *hist = job->histogram + tid * RADIX_BUCKETS;
+  uint32_t *keys = job->keys[job->src];
+  size_t    begin, end;
+  parallel_range(job->count, tid, threads, &begin, &end);
+  for(size_t b = 0; b < RADIX_BUCKETS; ++b) hist[b] = 0;
+  for(size_t i = begin; i < end; ++i) hist[(keys[i] >> job->shift) & (RADIX_BUCKETS - 1)]++;
+}
+
+// Each thread scatters its own chunk at the offsets computed for it, which keeps the pass stable
+static void scatter_digits(void *ctx, size_t tid, size_t threads)
+{
+  SortJob  *job      = ctx;
+  size_t   *offset   = job->histogram + tid * RADIX_BUCKETS;
+  uint32_t *keys     = job->keys[job->src];
+  size_t   *index    = job->index[job->src];
+  uint32_t *out_keys = job->keys[!job->src];
+  size_t   *out_idx  = job->index[!job->src];
+  size_t    begin, end;
+  parallel_range(job->count, tid, threads, &begin, &end);
+  for(size_t i = begin; i < end; ++i)
+    {
+      size_t dst    = offset[(keys[i] >> job->shift) & (RADIX_BUCKETS - 1)]++;
+      out_keys[dst] = keys[i];
+      out_idx[dst]  = index[i];
+    }
+}
+
+static void gather_points(void *ctx, size_t tid, size_t threads)
+{
+  SortJob *job   = ctx;
+  size_t  *index = job->index[job->src];
+  size_t   begin, end;
+  parallel_range(job->count, tid, threads, &begin, &end);
+  for(size_t i = begin; i < end; ++i)
+    {
+      job->sorted[i]   = job->items[index[i]];
+      job->new_perm[i] = job->old_perm[index[i]];
+    }
+}
+
+void spatial_order_reset(SpatialOrder *order, size_t count)
+{
+  if(order->capacity < count)
+    {
+      order->capacity = count;
+      order->perm     = realloc(order->perm, order->capacity * sizeof(size_t));
+    }
+  for(size_t i = 0; i < count; ++i) order->perm[i] = i;
+  order->count = count;
+}
+
+void spatial_order_free(SpatialOrder *order)
+{
+  free(order->perm);
+  *order = (SpatialOrder){0};
+}
+
+void spatial_sort(Samples3D *s, SpatialOrder *order)
+{
+  if(order->count != s->count) spatial_order_reset(order, s->count);
+  if(s->count < 2) return;
+
+  Vector3 lo = s->items[0], hi = s->items[0];
+  for(size_t i = 1; i < s->count; ++i)
+    {
+      lo = Vector3Min(lo, s->items[i]);
+      hi = Vector3Max(hi, s->items[i]);
+    }
+  float   cells = (float)((1 << MORTON_BITS) - 1);
+  Vector3 ext   = Vector3Subtract(hi, lo);
+
+  size_t  threads = parallel_thread_count();
+  SortJob job     = {
+        .items     = s->items,
+        .count     = s->count,
+        .min       = lo,
+        .scale     = {ext.x > 0 ? cells / ext.x : 0, ext.y > 0 ? cells / ext.y : 0, ext.z > 0 ? cells / ext.z : 0},
+        .keys      = {malloc(s->count * sizeof(uint32_t)), malloc(s->count * sizeof(uint32_t))},
+        .index     = {malloc(s->count * sizeof(size_t)), malloc(s->count * sizeof(size_t))},
+        .histogram = malloc(threads * RADIX_BUCKETS * sizeof(size_t)),
+        .src       = 0,
+        .old_perm  = order->perm,
+        .new_perm  = malloc(order->capacity * sizeof(size_t)),
+        .sorted    = malloc(s->capacity * sizeof(Vector3)),
+  };
+
+  parallel_run(threads, compute_keys, &job);
+
+  for(int pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+      job.shift = pass * RADIX_BITS;
+      parallel_run(threads, count_digits, &job);
+
+      // exclusive prefix sum, bucket-major then thread order
+      size_t running = 0;
+      for(size_t b = 0; b < RADIX_BUCKETS; ++b)
+        for(size_t t = 0; t < threads; ++t)
+          {
+            size_t c                             = job.histogram[t * RADIX_BUCKETS + b];
+            job.histogram[t * RADIX_BUCKETS + b] = running;
+            running += c;
+          }
+
+      parallel_run(threads, scatter_digits, &job);
+      job.src = !job.src;
+    }
+
+  parallel_run(threads, gather_points, &job);
+
+  numa_free(s->items); // may be a placed buffer
+  s->items = job.sorted;
+  free(order->perm);
+  order->perm = job.new_perm;
+
+  free(job.keys[0]);
+  free(job.keys[1]);
+  free(job.index[0]);
+  free(job.index[1]);
+  free(job.histogram);
+}
+
+// Puts every point back at its original index and resets the permutation.
+// Returns false, leaving the set alone, when the permutation does not describe it (the set changed since it was sorted).
+bool spatial_unsort(Samples3D *s, SpatialOrder *order)
+{
+  if(order->count != s->count) return false;
+
+  Vector3 *original = malloc(s->capacity * sizeof(Vector3));
+  for(size_t i = 0; i < s->count; ++i) original[order->perm[i]] = s->items[i];
+  numa_free(s->items); // may be a placed buffer
+  s->items = original;
+  spatial_order_reset(order, s->count);
+  return true;
+}
@@ -0,0 +1,149 @@
+#include "stream.h"
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+static struct
+{
+  bool            active;
+  bool            stopping;
+  FILE           *file;
+  pthread_t       producer;
+  pthread_mutex_t lock;
+
+  Vector3 queue[STREAM_QUEUE_SIZE];
+  size_t  head; // written by the producer
+  size_t  tail; // read by the render thread
+
+  StreamStats stats;
+} stream = {0};
+
+static void stream_sleep_ms(long ms)
+{
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+static bool stream_stopping(void)
+{
+  pthread_mutex_lock(&stream.lock);
+  bool stopping = stream.stopping;
+  pthread_mutex_unlock(&stream.lock);
+  return stopping;
+}
+
+// Queue one point, waiting while the queue is full: a slow consumer pushes back on the producer, never the other way
+static void stream_push(Vector3 p)
+{
+  for(;;)
+    {
+      pthread_mutex_lock(&stream.lock);
+      if(stream.stopping || stream.head - stream.tail < STREAM_QUEUE_SIZE)
+        {
+          stream.queue[stream.head % STREAM_QUEUE_SIZE] = p;
+          stream.head++;
+          stream.stats.received++;
+          pthread_mutex_unlock(&stream.lock);
+          return;
+        }
+      pthread_mutex_unlock(&stream.lock);
+      stream_sleep_ms(1);
+    }
+}
+
+static bool stream_coord_valid(float v) { return isfinite(v) && fabsf(v) <= STREAM_MAX_COORD; }
+
+static bool stream_point_valid(Vector3 p) { return stream_coord_valid(p.x) && stream_coord_valid(p.y) && stream_coord_valid(p.z); }
+
+static void *producer_main(void *arg)
+{
+  (void)arg;
+  char line[256];
+
+  while(!stream_stopping())
+    {
+      if(!fgets(line, sizeof(line), stream.file))
+        {
+          // end of file: wait for more to be appended (or for a new writer on a pipe)
+          clearerr(stream.file);
+          stream_sleep_ms(20);
+          continue;
+        }
+      if(line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+
+      Vector3 p;
+      if(sscanf(line, "%f %f %f", &p.x, &p.y, &p.z) == 3 && stream_point_valid(p)) { stream_push(p); }
+      else
+        {
+          pthread_mutex_lock(&stream.lock);
+          stream.stats.rejected++;
+          pthread_mutex_unlock(&stream.lock);
+        }
+    }
+  return NULL;
+}
+
+bool stream_start(const char *path)
+{
+  if(stream.active) return false;
+
+  stream.file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if(!stream.file)
+    {
+      TraceLog(LOG_ERROR, "STREAM: could not open %s", path);
+      return false;
+    }
+  stream.head     = 0;
+  stream.tail     = 0;
+  stream.stopping = false;
+  stream.stats    = (StreamStats){0};
+
+  pthread_mutex_init(&stream.lock, NULL);
+  pthread_create(&stream.producer, NULL, producer_main, NULL);
+  stream.active = true;
+  TraceLog(LOG_INFO, "STREAM: reading points from %s", path);
+  return true;
+}
+
+void stream_stop(void)
+{
+  if(!stream.active) return;
+
+  pthread_mutex_lock(&stream.lock);
+  stream.stopping = true;
+  pthread_mutex_unlock(&stream.lock);
+
+  // the producer may be blocked in a read on an idle pipe; reads are cancellation points
+  pthread_cancel(stream.producer);
+  pthread_join(stream.producer, NULL);
+  pthread_mutex_destroy(&stream.lock);
+
+  if(stream.file != stdin) fclose(stream.file);
+  stream.file   = NULL;
+  stream.active = false;
+}
+
+size_t stream_poll(Vector3 *out, size_t max)
+{
+  if(!stream.active) return 0;
+
+  pthread_mutex_lock(&stream.lock);
+  size_t n = stream.head - stream.tail;
+  if(n > max) n = max;
+  for(size_t i = 0; i < n; ++i) { out[i] = stream.queue[(stream.tail + i) % STREAM_QUEUE_SIZE]; }
+  stream.tail += n;
+  stream.stats.ingested += n;
+  pthread_mutex_unlock(&stream.lock);
+  return n;
+}
+
+bool stream_active(void) { return stream.active; }
+
+StreamStats stream_stats(void)
+{
+  if(!stream.active) return stream.stats;
+  pthread_mutex_lock(&stream.lock);
+  StreamStats s = stream.stats;
+  pthread_mutex_unlock(&stream.lock);
+  return s;
+}